@@ -35,6 +35,7 @@
 
 #include <memory.h>
 #include <stdlib.h>
+#include <vector>
 //#include <float.h>
 
 #include "Crescendo.h"
@@ -44,6 +45,8 @@
 #include "bark_fft.h"
 #include "ipp_intf.h"
 #include "old-dither.h"
+#include "tworker.h"
+#include "simd_vec.h"
 
 // -------------------------------------------------------------
 //
@@ -95,10 +98,17 @@ void TCrescendo::init_datawin()
         m_HalfWindow[ix]            = v;
         m_HalfWindow[m_hblksize-ix] = v;
     }
+    
+    // Sine Window over the whole block for WOLA analysis and synthesis.
+    // Its square is the Hann window, which sums to unity at 50% overlap.
+    m_SineWindow.realloc(m_blksize);
+    m_SineWindow[0] = 0.0;
+    for(UInt32 ix = 1; ix < m_blksize; ++ix)
+        m_SineWindow[ix] = sin(pif * ix);
 }
 
 // ---------------------------------------------------------
-Float64 TCrescendo_bark_channel::compute_hcgain(Float64 dbpwr, bark_rec *pbark)
+Float64 TCrescendo_bark_channel::compute_hcgain(Float64 dbpwr, UInt32 ix)
 {
 	Float64 dbgain = 0.0;
 	
@@ -113,8 +123,18 @@ Float64 TCrescendo_bark_channel::compute_hcgain(Float64 dbpwr, bark_rec *pbark)
             dbpwr = 100.0 - dbpwr * dbpwr * (100.0 - foldback);
         }
 #endif
-		dbgain = POST_SCALE(INTERPOLATE(dbpwr, pbark->interp_frac,
-                                        pbark->pcoff1, pbark->pcoff2));
+        const gain_tables *tbl = m_ActiveTables;
+        if(tbl)
+        {
+            Float64 t = (dbpwr - GAIN_TABLE_LO) * (1.0/GAIN_TABLE_STEP);
+            t = max(0.0, min(t, (Float64)(GAIN_TABLE_SIZE-1)));
+            UInt32 jx = min((UInt32)t, (UInt32)(GAIN_TABLE_SIZE-2));
+            const Float32 *g = tbl->gain[ix] + jx;
+            dbgain = g[0] + (t - jx) * (g[1] - g[0]);
+        }
+        else
+            dbgain = POST_SCALE(INTERPOLATE(dbpwr, m_bands.interp_frac[ix],
+                                            m_bands.pcoff1[ix], m_bands.pcoff2[ix]));
         dbgain = min(get_MaxGain(), dbgain);
         
 #if 1
@@ -122,14 +142,14 @@ Float64 TCrescendo_bark_channel::compute_hcgain(Float64 dbpwr, bark_rec *pbark)
         // to protect against abrupt gain rise around
         // foldback level at noise floor
         
-        Float64 gprev = pbark->prev_gain;
+        Float64 gprev = m_bands.prev_gain[ix];
         Float64 grls  = get_GainRelease();
 
         if(dbgain < (gprev - 6.0))
             gprev = dbgain;
         else
-            gDither.safe_relax(gprev, dbgain, grls);
-        pbark->prev_gain = gprev;
+            m_Dither.safe_relax(gprev, dbgain, grls);
+        m_bands.prev_gain[ix] = gprev;
         dbgain = gprev;
 #endif
         
@@ -165,9 +185,12 @@ inline Float64 gdbhl_to_gdbspl(Float64 gainhl, Float64 fletch)
 void TCrescendo::update_filter(Float64 *pin, TCrescendo_bark_channel *chan)
 {
     compute_power_spectrum(pin, chan);
-    update_bark_powers(chan);
+    if(m_FloatAnalysis)
+        update_bark_powers(chan, chan->get_PowerSpectrumF());
+    else
+        update_bark_powers(chan);
     chan->compute_bark_gains();
-    compute_filter();
+    compute_filter(chan);
 }
 
 void TCrescendo_bark_channel::compute_crest_factor(Float64 *pdata, UInt32 nel)
@@ -189,42 +212,77 @@ void TCrescendo_bark_channel::compute_crest_factor(Float64 *pdata, UInt32 nel)
 }
 
 
-void TCrescendo_bark_channel::select_data_for_power_estimation(Float64 *pin,
-                                                               Float64 *pwr_spectrum,
-                                                               UInt32  hblksize)
+void TCrescendo::compute_power_spectrum(Float64 *pin, TCrescendo_bark_channel *chan)
 {
-    // windowed transform of latest half-block for filter creation
-    switch(m_ioff)
-    {
-        case 0:
-            dcopy(pin+2*hblksize, pwr_spectrum,          hblksize);
-            dcopy(pin+0*hblksize, pwr_spectrum+hblksize, hblksize);
-            break;
-            
-            
-        case 1:
-            dcopy(pin+0*hblksize, pwr_spectrum,          2*hblksize);
-            break;
-            
-        case 2:
-            dcopy(pin+1*hblksize, pwr_spectrum,          2*hblksize);
-            break;
-    }
+    Float64 *pwr_spectrum = chan->get_PowerSpectrum();
+    Float64 *pwin = m_DataWindow();
+    
+    Float64 *seg = chan->power_segment(pin, m_hblksize);
+    
+    // The spectrum only feeds the band powers, and single precision is
+    // ample there: bands within 120 dB of the total come out within
+    // 0.002 dB of the double spectrum. Only cells < 128 are used.
+    chan->compute_crest_factor(seg + m_qblksize, m_hblksize);
+    if(m_FloatAnalysis)
+        chan->get_FFT()->fwd_windowed(seg, pwin, chan->get_PowerSpectrumF(), 128);
+    else
+        chan->get_FFT()->fwd_windowed(seg, pwin, pwr_spectrum, 128);
 }
 
-void TCrescendo::compute_power_spectrum(Float64 *pin, TCrescendo_bark_channel *chan)
+void TCrescendo::compute_reusable_spectrum(Float64 *pin, Float64 *spec, TCrescendo_bark_channel *chan)
 {
-    Float64 *pwr_spectrum = get_PowerSpectrum();
-    Float64 *pwin = m_DataWindow();
+    // Unwindowed transform of the power estimation segment.
+    // On the next hop this same segment is the one selected for filtering,
+    // so its spectrum is kept by the channel and the data FFT is skipped.
+    Float64 *seg = chan->power_segment(pin, m_hblksize);
     
-    chan->select_data_for_power_estimation(pin, pwr_spectrum, m_hblksize);
-    chan->compute_crest_factor(pwr_spectrum + m_qblksize, m_hblksize);
+    chan->compute_crest_factor(seg + m_qblksize, m_hblksize);
+    chan->get_FFT()->fwd(seg, spec);
+    window_spectrum(spec, chan->get_PowerSpectrum());
+}
+
+void TCrescendo::window_spectrum(Float64 *spec, Float64 *pwr_spectrum)
+{
+    // m_DataWindow is a periodic Hann window,
+    //   w[n] = 1/2 - 1/4 exp(2 pi i n/N) - 1/4 exp(-2 pi i n/N)
+    // so windowing is a 3-tap convolution in the frequency domain,
+    //   Y[k] = 1/2 X[k] - 1/4 (X[k-1] + X[k+1])
+    // with X[-1] = X*[1] and X[N/2+1] = X*[N/2-1].
+    Float64 dc, nyq, re0, im0, re1, im1, re2, im2;
     
-    dmul3(pwin, pwr_spectrum, pwr_spectrum, (int)m_blksize);
-    m_AudioFFT->fwd(pwr_spectrum);
+    get_FT_DC(spec, dc);
+    get_FT_Nyquist(spec, nyq);
+    get_FT_cell(spec, 1, re1, im1);
+    set_FT_DC(pwr_spectrum, 0.5*(dc - re1));
+    
+    re0 = dc;
+    im0 = 0.0;
+    for(UInt32 ix = 1; ix < m_hblksize; ++ix)
+    {
+        if(ix+1 < m_hblksize)
+            get_FT_cell(spec, ix+1, re2, im2);
+        else
+        {
+            re2 = nyq;
+            im2 = 0.0;
+        }
+        set_FT_cell(pwr_spectrum, ix,
+                    0.5*re1 - 0.25*(re0 + re2),
+                    0.5*im1 - 0.25*(im0 + im2));
+        re0 = re1; im0 = im1;
+        re1 = re2; im1 = im2;
+    }
+    set_FT_Nyquist(pwr_spectrum, 0.5*(nyq - re0));
 }
 
 void TCrescendo::self_calibrate()
+{
+    m_selfCalHann = calibrate_window(m_DataWindow());
+    m_selfCalSine = calibrate_window(m_SineWindow());
+    m_selfCalSF   = (m_WOLA ? m_selfCalSine : m_selfCalHann);
+}
+
+Float64 TCrescendo::calibrate_window(Float64 *pwin)
 {
     // Self calibration for power estimation
     // The character of the FFT routine, its scaling,
@@ -235,9 +293,8 @@ void TCrescendo::self_calibrate()
     // correction term for use during the running measurements
     // of signal power.
     
-    Float64 *pwr_spectrum = get_PowerSpectrum();
-    Float64 *pwin = m_DataWindow();
-    Float64 *bark_spectrum = get_BarkSpectrum();
+    Float64 *pwr_spectrum = m_Work.get_PowerSpectrum();
+    Float64 *bark_spectrum = m_Work.get_BarkSpectrum();
     
     // Construct a unit amplitude sinewave exactly subharmonic of sample rate.
     // At 48 kHz, this is about 1.5 kHz.
@@ -255,22 +312,34 @@ void TCrescendo::self_calibrate()
     // Sum over the signal power the same way we do during processing.
 
     dmul3(pwin, pwr_spectrum, pwr_spectrum, (int)m_blksize);
-    m_AudioFFT->fwd(pwr_spectrum);
+    m_Work.get_FFT()->fwd(pwr_spectrum);
     
-    Float64 *savEQ = m_UnifiedEQAmpl;
+    const Float64 *savEQ = m_UnifiedEQAmpl;
     m_UnifiedEQAmpl = dummyEQ;
     Float64 pwrsum = compute_bark_powers(pwr_spectrum, bark_spectrum);
     m_UnifiedEQAmpl = savEQ;
     
-    // save the factor which represents twice this total power for the 0 dB level.
-    m_selfCalSF = db10(2.0*pwrsum);
+    // the factor which represents twice this total power for the 0 dB level.
+    return db10(2.0*pwrsum);
 }
 
 
 void TCrescendo::update_bark_powers(TCrescendo_bark_channel *chan)
 {
-    Float64 *bark_spectrum = get_BarkSpectrum();
-    Float64 *pwr_spectrum  = get_PowerSpectrum();
+    update_bark_powers(chan, chan->get_PowerSpectrum());
+}
+
+void TCrescendo::update_bark_powers(TCrescendo_bark_channel *chan, Float32 *pwr_spectrum)
+{
+    Float64 *bark_spectrum = chan->get_BarkSpectrum();
+    Float64  total_pwr = db10(compute_bark_powers(pwr_spectrum, bark_spectrum)) - get_selfCalSF();
+    
+    chan->update_level(total_pwr);
+}
+
+void TCrescendo::update_bark_powers(TCrescendo_bark_channel *chan, Float64 *pwr_spectrum)
+{
+    Float64 *bark_spectrum = chan->get_BarkSpectrum();
     
     // split FFT power into Bark bands
     Float64 total_pwr = db10(compute_bark_powers(pwr_spectrum, bark_spectrum)) - get_selfCalSF();
@@ -281,19 +350,78 @@ void TCrescendo::update_bark_powers(TCrescendo_bark_channel *chan)
 
 void TCrescendo_bark_channel::update_level(Float64 total_pwr)
 {
-    gDither.safe_relax(m_level, total_pwr, get_LevelAlpha());
+    m_Dither.safe_relax(m_level, total_pwr, get_LevelAlpha());
+}
+
+void TCrescendo_bark_channel::compute_bark_levels(Float64 *xdb, UInt32 nbands)
+{
+    // measured band powers in dB, less the self calibration
+	Float64 *bpwr    = get_BarkSpectrum();
+    Float64  selfcal = get_selfCalSF();
+    if(get_FastDBMath())
+        vdb10(bpwr, xdb, nbands);
+    else
+    {
+        for(UInt32 ix = 0; ix < nbands; ++ix)
+            xdb[ix] = db10(bpwr[ix]);
+    }
+    for(UInt32 ix = 0; ix < nbands; ++ix)
+        xdb[ix] -= selfcal;
+}
+
+void TCrescendo_bark_channel::link_bark_powers(TCrescendo_bark_channel *other, UInt32 mode)
+{
+    // fold the other channel's band powers and crest factor into ours,
+    // so that our gain curve serves both
+	Float64 *bpwr = get_BarkSpectrum();
+	Float64 *opwr = other->get_BarkSpectrum();
+    if(kStereoLinkMax == mode)
+    {
+        for(UInt32 ix = 0; ix < NSUBBANDS*NFBANDS; ++ix)
+            bpwr[ix] = max(bpwr[ix], opwr[ix]);
+    }
+    else
+    {
+        for(UInt32 ix = 0; ix < NSUBBANDS*NFBANDS; ++ix)
+            bpwr[ix] = 0.5*(bpwr[ix] + opwr[ix]);
+    }
+    m_Crest = max(m_Crest, other->m_Crest);
 }
 
 void TCrescendo_bark_channel::compute_bark_gains()
 {
-	Float64 *bpwr  = get_BarkSpectrum();
+    leave_lanes();
+    
+    // tables built for the current vtune, GAIN_TABLE_HOPS after it
+    // changed or later, never sooner. Until they are published the
+    // rational fits serve.
+    m_ActiveTables = 0;
+    if(m_TableHops < GAIN_TABLE_HOPS)
+        ++m_TableHops;
+    else if(m_parent->get_GainTables())
+    {
+        const gain_tables *tbl = get_PublishedTables();
+        if(tbl && tbl->serial == m_bandsSerial)
+            m_ActiveTables = tbl;
+    }
+    
+    if(get_VectorBarkGains())
+        compute_bark_gains_vector();
+    else
+        compute_bark_gains_scalar();
+}
+
+void TCrescendo_bark_channel::compute_bark_gains_scalar()
+{
 	Float64 *bgain = get_BarkGains();
+    Float64  xdb[NSUBBANDS*NFBANDS];
+    
+    compute_bark_levels(xdb, NSUBBANDS*NFBANDS);
     
 	// compute upward and downward masking contributions
 	//compute_masks(cpwr);
     
 	// now compute Bark channel output gains
-	bark_rec *pbark     = m_bark;
 	Float64 attendb     = get_AttendB(); // processing headroom, to be made up externally
 	Float64 voldb       = get_VoldB();   // desired volume boost
     Float64 gain0       = attendb + voldb;
@@ -315,36 +443,36 @@ void TCrescendo_bark_channel::compute_bark_gains()
 	}
 #endif
     // > 250 Hz we have VTuning corrections
-	for(int ix = 0; ix < NSUBBANDS*NFBANDS; ++ix, ++pbark)
+	for(int ix = 0; ix < NSUBBANDS*NFBANDS; ++ix)
 	{
 		// -----------------------------------------------------------------------
 		// compute attack and release on measured power
 		// uses a fast attack and slower release, plus a hold
         
-		Float64 xpwr = db10(bpwr[ix]) - get_selfCalSF();
-		Float64 mn   = pbark->mean_pwr;
-		gDither.safe_relax(mn, xpwr, releaseSlow);
-		pbark->mean_pwr = mn;
+		Float64 xpwr = xdb[ix];
+		Float64 mn   = m_bands.mean_pwr[ix];
+		m_Dither.safe_relax(mn, xpwr, releaseSlow);
+		m_bands.mean_pwr[ix] = mn;
         
 		Float64 crest = m_Crest;
-		Float64 prev = pbark->prev_pwr;
+		Float64 prev = m_bands.prev_pwr[ix];
         
 		if(xpwr > prev)
 		{
             // instantaneous attack >= 6 dB
             if(xpwr + crest > prev + 6.0)
 		    {
-                pbark->release = releaseFast; // 50 ms
-                pbark->holdctr = holdct;
+                m_bands.release[ix] = releaseFast; // 50 ms
+                m_bands.holdctr[ix] = holdct;
                 prev = xpwr + crest;
 		    }
             else
-                gDither.safe_relax(prev, xpwr, releaseFast);
+                m_Dither.safe_relax(prev, xpwr, releaseFast);
 		}
-		else if(pbark->holdctr > 0)
+		else if(m_bands.holdctr[ix] > 0)
 		{
 			// hold until hold counter empties
-			--pbark->holdctr;
+			m_bands.holdctr[ix] -= 1.0;
 		}
 		else
 		{
@@ -359,11 +487,11 @@ void TCrescendo_bark_channel::compute_bark_gains()
 			//
             
 			if (prev < mn + 3.0) // 3 dB
-				pbark->release = releaseSlow; // 200 ms
+				m_bands.release[ix] = releaseSlow; // 200 ms
             
-			gDither.safe_relax(prev, xpwr, pbark->release);
+			m_Dither.safe_relax(prev, xpwr, m_bands.release[ix]);
 		}
-		pbark->prev_pwr = prev;
+		m_bands.prev_pwr[ix] = prev;
 		xpwr = prev;
         
 		// -----------------------------------------------------------------------
@@ -387,7 +515,7 @@ void TCrescendo_bark_channel::compute_bark_gains()
 			// conversion from dBFS to dBSPL
             
 			Float64 pwrhl = m_parent->dbfs_to_dbhl(pwrdb, fletch);
-			Float64 dbhc = compute_hcgain(pwrhl, pbark);
+			Float64 dbhc = compute_hcgain(pwrhl, ix);
             
 			// correction gain to be applied in SPL space
 			dgain = gdbhl_to_gdbspl(dbhc, fletch);
@@ -403,189 +531,1353 @@ void TCrescendo_bark_channel::compute_bark_gains()
 	}
 }
 
-void TCrescendo::compute_filter()
+void TCrescendo_bark_channel::compute_bark_gains_vector()
 {
-    Float64 *bgain = get_BarkGains();
-    Float64 *pwr_spectrum = get_PowerSpectrum();
-    Float64 *filter = m_Filter();
-    Float64 *pwin   = m_HalfWindow();
+    // compute_bark_gains_scalar() across VD_LANES bands at a time.
+    // Every branch there becomes a lane mask here, both sides are
+    // computed and the mask selects. The dBHL conversions use the
+    // per-band factors from the constructor, the dither for the
+    // relaxations comes in bulk. Agrees with the scalar path to well
+    // within 0.01 dB.
+	Float64 *bgain = get_BarkGains();
+    const UInt32 nbands = NSUBBANDS*NFBANDS;
     
-    compute_ft_gains(bgain, pwr_spectrum);
-    m_AudioFFT->inv(pwr_spectrum);
-    dmul3(pwin+m_qblksize, pwr_spectrum, filter, m_qblksize);
-    dzero(filter+m_qblksize, m_hblksize);
-    dmul3(pwin, pwr_spectrum+3*m_qblksize, filter+3*m_qblksize, m_qblksize);
-    m_AudioFFT->fwd(filter);
+    Float64 xdb[nbands];
+    Float64 dmean[nbands];
+    Float64 dprev[nbands];
+    Float64 dgain[nbands];
+    
+    compute_bark_levels(xdb, nbands);
+    m_Dither.relax_dither_block(dmean, nbands);
+    m_Dither.relax_dither_block(dprev, nbands);
+    m_Dither.relax_dither_block(dgain, nbands);
+    
+	Float64 attendb     = get_AttendB();
+	Float64 voldb       = get_VoldB();
+    
+    TVecD releaseSlow = vd_splat(get_ReleaseSlow());
+    TVecD releaseFast = vd_splat(get_ReleaseFast());
+    TVecD holdct      = vd_splat((Float64)get_HoldCt());
+    TVecD crest       = vd_splat(m_Crest);
+    TVecD gain0       = vd_splat(attendb + voldb);
+    TVecD toSPL       = vd_splat(convert_dBFS_to_dBSPL(voldb));
+    TVecD foldback    = vd_splat(get_Foldback());
+    TVecD fbrange     = vd_splat(100.0 - get_Foldback());
+    TVecD maxgain     = vd_splat(get_MaxGain());
+    TVecD grls        = vd_splat(get_GainRelease());
+    TVecD zero        = vd_splat(0.0);
+    TVecD one         = vd_splat(1.0);
+    TVecD two         = vd_splat(2.0);
+    TVecD three       = vd_splat(3.0);
+    TVecD six         = vd_splat(6.0);
+    TVecD thirty      = vd_splat(30.0);
+    TVecD hundred     = vd_splat(100.0);
+    bool  proc        = get_Processing();
+    
+    UInt32 ix = 0;
+	for(; ix + VD_LANES <= nbands; ix += VD_LANES)
+	{
+		// attack, hold and release on measured power
+        TVecD xpwr = vd_load(xdb + ix);
+        TVecD mn   = vd_load(m_bands.mean_pwr + ix);
+        mn = vd_add(mn, vd_mul(releaseSlow, vd_sub(vd_add(xpwr, vd_load(dmean + ix)), mn)));
+        vd_store(m_bands.mean_pwr + ix, mn);
+        
+        TVecD prev = vd_load(m_bands.prev_pwr + ix);
+        TVecD rls  = vd_load(m_bands.release + ix);
+        TVecD hold = vd_load(m_bands.holdctr + ix);
+        TVecD peak = vd_add(xpwr, crest);
+        
+        TMaskD attack  = vd_gt(xpwr, prev);
+        TMaskD jump    = vm_and(attack, vd_gt(peak, vd_add(prev, six)));
+        TMaskD rise    = vm_andnot(jump, attack);
+        TMaskD holding = vm_andnot(attack, vd_gt(hold, zero));
+        TMaskD falling = vm_andnot(attack, vd_le(hold, zero));
+        TMaskD toslow  = vm_and(falling, vd_lt(prev, vd_add(mn, three)));
+        
+        rls  = vd_select(jump, releaseFast, vd_select(toslow, releaseSlow, rls));
+        hold = vd_select(jump, holdct, vd_select(holding, vd_sub(hold, one), hold));
+        
+        TVecD tc      = vd_select(rise, releaseFast, vd_select(falling, rls, zero));
+        TVecD relaxed = vd_add(prev, vd_mul(tc, vd_sub(vd_add(xpwr, vd_load(dprev + ix)), prev)));
+        prev = vd_select(jump, peak, vd_select(vm_or(rise, falling), relaxed, prev));
+        
+        vd_store(m_bands.release + ix, rls);
+        vd_store(m_bands.holdctr + ix, hold);
+        vd_store(m_bands.prev_pwr + ix, prev);
+        
+        if(!proc)
+        {
+            vd_store(bgain + ix, gain0);
+            continue;
+        }
+        
+		// HC gains, see compute_hcgain()
+        TVecD pwrhl = vd_div(vd_add(prev, toSPL), vd_load(m_bands.hl_div + ix));
+        
+        TMaskD audible = vd_gt(pwrhl, thirty);
+        TVecD  fb      = vd_div(pwrhl, foldback);
+        fb = vd_sub(hundred, vd_mul(vd_mul(fb, fb), fbrange));
+        TVecD  dbpwr   = vd_select(vd_lt(pwrhl, foldback), fb, pwrhl);
+        
+        TVecD frac = vd_load(m_bands.interp_frac + ix);
+        TVecD g1, g2;
+        {
+            Float64 (*c)[NBARKS] = m_bands.coff1;
+            TVecD c0 = vd_load(c[0] + ix);
+            TVecD x  = vd_sub(one, vd_div(vd_mul(two, vd_min(zero, vd_max(vd_sub(dbpwr, hundred), c0))), c0));
+            TVecD num = vd_add(vd_mul(vd_add(vd_mul(vd_load(c[3] + ix), x), vd_load(c[2] + ix)), x), vd_load(c[1] + ix));
+            TVecD den = vd_add(vd_mul(vd_add(vd_mul(vd_load(c[5] + ix), x), vd_load(c[4] + ix)), x), one);
+            g1 = vd_div(num, den);
+        }
+        {
+            Float64 (*c)[NBARKS] = m_bands.coff2;
+            TVecD c0 = vd_load(c[0] + ix);
+            TVecD x  = vd_sub(one, vd_div(vd_mul(two, vd_min(zero, vd_max(vd_sub(dbpwr, hundred), c0))), c0));
+            TVecD num = vd_add(vd_mul(vd_add(vd_mul(vd_load(c[3] + ix), x), vd_load(c[2] + ix)), x), vd_load(c[1] + ix));
+            TVecD den = vd_add(vd_mul(vd_add(vd_mul(vd_load(c[5] + ix), x), vd_load(c[4] + ix)), x), one);
+            g2 = vd_div(num, den);
+        }
+        TVecD dbgain = vd_add(vd_mul(vd_sub(one, frac), g1), vd_mul(frac, g2));
+        dbgain = vd_min(maxgain, dbgain);
+        
+        // dynamic profile on correction gain
+        TVecD  gprev = vd_load(m_bands.prev_gain + ix);
+        TMaskD drop  = vd_lt(dbgain, vd_sub(gprev, six));
+        TVecD  grel  = vd_add(gprev, vd_mul(grls, vd_sub(vd_add(dbgain, vd_load(dgain + ix)), gprev)));
+        gprev = vd_select(audible, vd_select(drop, dbgain, grel), gprev);
+        vd_store(m_bands.prev_gain + ix, gprev);
+        
+        TVecD dbhc = vd_select(audible, gprev, zero);
+        vd_store(bgain + ix, vd_add(gain0, vd_mul(dbhc, vd_load(m_bands.spl_mul + ix))));
+	}
+    // no tail for 100 bands at 1, 2 or 4 lanes
 }
 
-//-------------------------------------------------------------------
+// the band state that a bark_lanes block holds for its channels
+static Float64 (bark_bands::*const kBandState[])[NBARKS] = {
+    &bark_bands::mean_pwr, &bark_bands::prev_pwr, &bark_bands::release,
+    &bark_bands::holdctr, &bark_bands::prev_gain
+};
+static Float64 (bark_lanes::*const kLaneState[])[NBARKS*VD_LANES] = {
+    &bark_lanes::mean_pwr, &bark_lanes::prev_pwr, &bark_lanes::release,
+    &bark_lanes::holdctr, &bark_lanes::prev_gain
+};
 
-void TCrescendo_bark_channel::select_data_for_filtering(Float64 *pin,
-                                                        Float64 *data,
-                                                        UInt32   hblksize)
+void TCrescendo_bark_channel::enter_lanes(bark_lanes *lw, UInt32 lane)
 {
-    // pin points to a buffer of 3*hblksize input samples
-    // m_ioff is the index of half blocks into pin, at which the latest input had been saved
-    // delay is 1/2 block = 2.67 ms from input @ 48 kHz
-    switch(m_ioff)
+    if(m_LaneHome == lw)
+        return;
+    leave_lanes();
+    for(UInt32 kx = 0; kx < 5; ++kx)
     {
-        case 0:
-            // we just saved at index 0, so process segments 1 & 2
-            dcopy(pin+1*hblksize, data,          2*hblksize);
-            break;
-            
-            
-        case 1:
-            // we just saved at index 1, so process segments 2 & 0
-            dcopy(pin+2*hblksize, data,          hblksize);
-            dcopy(pin+0*hblksize, data+hblksize, hblksize);
-            break;
-            
-        case 2:
-            // we just saved at index 2, so process segments 0 & 1
-            dcopy(pin+0*hblksize, data,          2*hblksize);
-            break;
+        const Float64 *src = m_bands.*kBandState[kx];
+        Float64       *dst = lw->*kLaneState[kx] + lane;
+        for(UInt32 ix = 0; ix < NSUBBANDS*NFBANDS; ++ix)
+            dst[ix*VD_LANES] = src[ix];
     }
+    m_LaneHome = lw;
+    m_Lane     = lane;
 }
 
-void TCrescendo::render_samples(Float64 *pin, Float64 *data, TCrescendo_bark_channel *chan)
+void TCrescendo_bark_channel::leave_lanes()
 {
-    update_filter(pin, chan);
-    
-    // non-windowed transform for data
-    // overlap-save convolution does not use data windowing
-    // 1/2 block delay from filter center = 2.67 ms at 48 kHz
-    chan->select_data_for_filtering(pin, data, m_hblksize);
-    m_AudioFFT->fwd(data);
-    m_AudioFFT->mulSpec(m_Filter(), data, data);
-    m_AudioFFT->inv(data);
+    if(!m_LaneHome)
+        return;
+    for(UInt32 kx = 0; kx < 5; ++kx)
+    {
+        const Float64 *src = m_LaneHome->*kLaneState[kx] + m_Lane;
+        Float64       *dst = m_bands.*kBandState[kx];
+        for(UInt32 ix = 0; ix < NSUBBANDS*NFBANDS; ++ix)
+            dst[ix] = src[ix*VD_LANES];
+    }
+    m_LaneHome = 0;
 }
 
-// -------------------------------------------------------------------------------------
-
-void TCrescendo_bark_channel::transfer_results_to_output(Float32* pout, UInt32 nel, bool replace)
+void TCrescendo_bark_channel::compute_bark_gains_lanes(bark_lanes *lw)
 {
-    Float64 *data = get_Data();
-    TDither dith(nel);
+    // compute_bark_gains_vector() with a channel in each lane in place
+    // of a band. The channels are on the same tuning, so the band
+    // coefficients are the same in every lane and go in by splat. The
+    // dither is drawn from each channel's stream as there, and each
+    // lane comes out as compute_bark_gains_vector() would have it.
+    // Band powers come in lw->bk_pwr, gains go out in lw->gain, and
+    // the band state is updated in place in the live lanes only.
+    const UInt32 nbands = NSUBBANDS*NFBANDS;
+    const UInt32 L      = VD_LANES;
+    TCrescendo_bark_channel *ch0 = 0;
+    Float64 *xdb = lw->bk_pwr;
+    Float64 *cols[VD_LANES];
+    UInt32   c;
     
-    m_obuf->get(data, nel, true);
-    if(replace)
-        dith.copy_dtos_with_dither(data, pout, nel);
+    for(c = 0; c < L; ++c)
+    {
+        TCrescendo_bark_channel *ch = lw->chan[c];
+        if(!ch)
+            continue;
+        if(!ch0)
+            ch0 = ch;
+        ch->enter_lanes(lw, c);
+        for(UInt32 kx = 0; kx < 3; ++kx)
+            ch->m_Dither.relax_dither_block(lw->dither[kx] + c, nbands, L);
+        lw->crest[c] = ch->m_Crest;
+        if(ch->m_TableHops < GAIN_TABLE_HOPS)
+            ++ch->m_TableHops;
+    }
+    for(c = 0; c < L; ++c)
+        if(!lw->chan[c])
+            lw->crest[c] = ch0->m_Crest;
+    const bark_bands &b0 = ch0->m_bands;
+    
+    // levels in dB, the self calibration comes off in the band loop,
+    // see compute_bark_levels()
+    if(ch0->get_FastDBMath())
+        vdb10(xdb, xdb, nbands*L);
     else
     {
-        for(UInt32 ix = 0; ix < nel; ++ix)
-            pout[ix] = dith.cvt_dtos(pout[ix] + data[ix]);
+        for(UInt32 ix = 0; ix < nbands*L; ++ix)
+            xdb[ix] = db10(xdb[ix]);
     }
+    
+	Float64 attendb     = ch0->get_AttendB();
+	Float64 voldb       = ch0->get_VoldB();
+    
+    TVecD releaseSlow = vd_splat(ch0->get_ReleaseSlow());
+    TVecD releaseFast = vd_splat(ch0->get_ReleaseFast());
+    TVecD holdct      = vd_splat((Float64)ch0->get_HoldCt());
+    TVecD crest       = vd_load(lw->crest);
+    TMaskD live       = vd_gt(vd_load(lw->live), vd_splat(0.0));
+    TVecD selfcal     = vd_splat(ch0->get_selfCalSF());
+    TVecD gain0       = vd_splat(attendb + voldb);
+    TVecD toSPL       = vd_splat(ch0->convert_dBFS_to_dBSPL(voldb));
+    TVecD foldback    = vd_splat(ch0->get_Foldback());
+    TVecD fbrange     = vd_splat(100.0 - ch0->get_Foldback());
+    TVecD maxgain     = vd_splat(ch0->get_MaxGain());
+    TVecD grls        = vd_splat(ch0->get_GainRelease());
+    TVecD zero        = vd_splat(0.0);
+    TVecD one         = vd_splat(1.0);
+    TVecD two         = vd_splat(2.0);
+    TVecD three       = vd_splat(3.0);
+    TVecD six         = vd_splat(6.0);
+    TVecD thirty      = vd_splat(30.0);
+    TVecD hundred     = vd_splat(100.0);
+    bool  proc        = ch0->get_Processing();
+    
+	for(UInt32 ix = 0; ix < nbands; ++ix)
+	{
+        UInt32 jx = ix*L;
+        
+		// attack, hold and release on measured power
+        TVecD xpwr = vd_sub(vd_load(xdb + jx), selfcal);
+        TVecD mn0  = vd_load(lw->mean_pwr + jx);
+        TVecD mn   = vd_add(mn0, vd_mul(releaseSlow, vd_sub(vd_add(xpwr, vd_load(lw->dither[0] + jx)), mn0)));
+        vd_store(lw->mean_pwr + jx, vd_select(live, mn, mn0));
+        
+        TVecD prev0 = vd_load(lw->prev_pwr + jx);
+        TVecD rls0  = vd_load(lw->release + jx);
+        TVecD hold0 = vd_load(lw->holdctr + jx);
+        TVecD prev = prev0;
+        TVecD rls  = rls0;
+        TVecD hold = hold0;
+        TVecD peak = vd_add(xpwr, crest);
+        
+        TMaskD attack  = vd_gt(xpwr, prev);
+        TMaskD jump    = vm_and(attack, vd_gt(peak, vd_add(prev, six)));
+        TMaskD rise    = vm_andnot(jump, attack);
+        TMaskD holding = vm_andnot(attack, vd_gt(hold, zero));
+        TMaskD falling = vm_andnot(attack, vd_le(hold, zero));
+        TMaskD toslow  = vm_and(falling, vd_lt(prev, vd_add(mn, three)));
+        
+        rls  = vd_select(jump, releaseFast, vd_select(toslow, releaseSlow, rls));
+        hold = vd_select(jump, holdct, vd_select(holding, vd_sub(hold, one), hold));
+        
+        TVecD tc      = vd_select(rise, releaseFast, vd_select(falling, rls, zero));
+        TVecD relaxed = vd_add(prev, vd_mul(tc, vd_sub(vd_add(xpwr, vd_load(lw->dither[1] + jx)), prev)));
+        prev = vd_select(jump, peak, vd_select(vm_or(rise, falling), relaxed, prev));
+        
+        vd_store(lw->release + jx, vd_select(live, rls, rls0));
+        vd_store(lw->holdctr + jx, vd_select(live, hold, hold0));
+        vd_store(lw->prev_pwr + jx, vd_select(live, prev, prev0));
+        
+        if(!proc)
+        {
+            vd_store(lw->gain + jx, gain0);
+            continue;
+        }
+        
+		// HC gains, see compute_hcgain()
+        TVecD pwrhl = vd_div(vd_add(prev, toSPL), vd_splat(b0.hl_div[ix]));
+        
+        TMaskD audible = vd_gt(pwrhl, thirty);
+        TVecD  fb      = vd_div(pwrhl, foldback);
+        fb = vd_sub(hundred, vd_mul(vd_mul(fb, fb), fbrange));
+        TVecD  dbpwr   = vd_select(vd_lt(pwrhl, foldback), fb, pwrhl);
+        
+        TVecD frac = vd_splat(b0.interp_frac[ix]);
+        TVecD g1, g2;
+        {
+            const Float64 (*c)[NBARKS] = b0.coff1;
+            TVecD c0 = vd_splat(c[0][ix]);
+            TVecD x  = vd_sub(one, vd_div(vd_mul(two, vd_min(zero, vd_max(vd_sub(dbpwr, hundred), c0))), c0));
+            TVecD num = vd_add(vd_mul(vd_add(vd_mul(vd_splat(c[3][ix]), x), vd_splat(c[2][ix])), x), vd_splat(c[1][ix]));
+            TVecD den = vd_add(vd_mul(vd_add(vd_mul(vd_splat(c[5][ix]), x), vd_splat(c[4][ix])), x), one);
+            g1 = vd_div(num, den);
+        }
+        {
+            const Float64 (*c)[NBARKS] = b0.coff2;
+            TVecD c0 = vd_splat(c[0][ix]);
+            TVecD x  = vd_sub(one, vd_div(vd_mul(two, vd_min(zero, vd_max(vd_sub(dbpwr, hundred), c0))), c0));
+            TVecD num = vd_add(vd_mul(vd_add(vd_mul(vd_splat(c[3][ix]), x), vd_splat(c[2][ix])), x), vd_splat(c[1][ix]));
+            TVecD den = vd_add(vd_mul(vd_add(vd_mul(vd_splat(c[5][ix]), x), vd_splat(c[4][ix])), x), one);
+            g2 = vd_div(num, den);
+        }
+        TVecD dbgain = vd_add(vd_mul(vd_sub(one, frac), g1), vd_mul(frac, g2));
+        dbgain = vd_min(maxgain, dbgain);
+        
+        // dynamic profile on correction gain
+        TVecD  gprev0 = vd_load(lw->prev_gain + jx);
+        TMaskD drop   = vd_lt(dbgain, vd_sub(gprev0, six));
+        TVecD  grel   = vd_add(gprev0, vd_mul(grls, vd_sub(vd_add(dbgain, vd_load(lw->dither[2] + jx)), gprev0)));
+        TVecD  gprev  = vd_select(audible, vd_select(drop, dbgain, grel), gprev0);
+        vd_store(lw->prev_gain + jx, vd_select(live, gprev, gprev0));
+        
+        TVecD dbhc = vd_select(audible, gprev, zero);
+        vd_store(lw->gain + jx, vd_add(gain0, vd_mul(dbhc, vd_splat(b0.spl_mul[ix]))));
+	}
+    // the band past the last, for the interpolation to cells
+    vd_store(lw->gain + nbands*L, zero);
+    
+    // the gains out to the channels, for measure_filter_deviation()
+    for(c = 0; c < L; ++c)
+        cols[c] = lw->chan[c] ? lw->chan[c]->get_BarkGains() : 0;
+    vd_deinterleave(lw->gain, cols, nbands);
+}
 
+Float64 TCrescendo_bark_channel::measure_vector_gains()
+{
+    // Run both gain paths from the current band state on the current
+    // Bark powers, and return their largest difference in dB. The
+    // band state, dither and gains are put back afterwards.
+    const UInt32 nbands = NSUBBANDS*NFBANDS;
+    leave_lanes();
+    bark_bands saveBands  = m_bands;
+    TDither    saveDither = m_Dither;
+    Float64    saveGains[nbands];
+    Float64    ref[nbands];
+    
+    memcpy(saveGains, get_BarkGains(), sizeof(saveGains));
+    compute_bark_gains_scalar();
+    memcpy(ref, get_BarkGains(), sizeof(ref));
+    m_bands  = saveBands;
+    m_Dither = saveDither;
+    compute_bark_gains_vector();
+    
+    Float64 *bgain = get_BarkGains();
+    Float64  dev   = 0.0;
+    for(UInt32 ix = 0; ix < nbands; ++ix)
+        dev = max(dev, fabs(bgain[ix] - ref[ix]));
+    
+    m_bands  = saveBands;
+    m_Dither = saveDither;
+    memcpy(get_BarkGains(), saveGains, sizeof(saveGains));
+    return dev;
 }
 
-void TCrescendo_bark_channel::render_channel(Float32 *pin,
-                                             Float32 *pout,
-                                             UInt32   nsamp,
-                                             bool     replace)
+void TCrescendo::compute_filter(TCrescendo_workspace *ws)
 {
-#if 0
-	FILE *fp = fopen("/Users/david/Crescendo/MacAudio/cresc_log.txt", "a");
-	fprintf(fp, "nsamp = %d\n", nsamp);
-	fprintf(fp, "pin = %p\n", pin);
-	fprintf(fp, "pout = %p\n", pout);
-	fclose(fp);
-#endif
-	Float64 *data = get_Data();
-	int      hblksize = get_hblksize();
-    int      qblksize = get_qblksize();
-	UInt32   nel  = hblksize - m_iscrap;
+    if(m_SpectralFilter)
+        compute_filter_spectral(ws, ws->get_Filter());
+    else
+        compute_filter_reference(ws, ws->get_Filter());
+}
+
+void TCrescendo::truncate_filter(TCrescendo_workspace *ws, Float64 *gains, Float64 *filter)
+{
+    // limit the impulse response of the gain spectrum to +/- 1/4 block
+    // with a half-block Hann window, so that the overlap-save convolution
+    // does not wrap around
+    Float64 *pwin = m_HalfWindow();
     
-	while(nsamp >= nel)
+    ws->get_FFT()->inv(gains);
+    dmul3(pwin+m_qblksize, gains, filter, m_qblksize);
+    dzero(filter+m_qblksize, m_hblksize);
+    dmul3(pwin, gains+3*m_qblksize, filter+3*m_qblksize, m_qblksize);
+    ws->get_FFT()->fwd(filter);
+}
+
+void TCrescendo::compute_filter_reference(TCrescendo_workspace *ws, Float64 *filter)
+{
+    Float64 *bgain = ws->get_BarkGains();
+    Float64 *pwr_spectrum = ws->get_PowerSpectrum();
+    
+    compute_ft_gains(bgain, pwr_spectrum);
+    truncate_filter(ws, pwr_spectrum, filter);
+}
+
+void TCrescendo::compute_filter_spectral(TCrescendo_workspace *ws, Float64 *filter)
+{
+    // Same filter as compute_filter_reference() without the two FFTs.
+    // The gain spectrum is real and even, and so is the transform of the
+    // truncation window, so the filter is just the gain spectrum smoothed
+    // by the sparse kernel from init_filter_kernel(). Gains vanish from
+    // cell 128 upward, so only cells up to 127 + span can be nonzero.
+    Float64 *bgain = ws->get_BarkGains();
+    Float64 *pwr_spectrum = ws->get_PowerSpectrum();
+    Float64  gpad[128 + 3*64];
+    SInt32   span = m_KernelSpan;
+    SInt32   hblk = m_hblksize;
+    SInt32   kmax = min(hblk, 127 + span);
+    Float64  re, im;
+    
+    compute_ft_gains(bgain, pwr_spectrum);
+    
+    // gains at cells -span .. kmax+span, mirrored about DC and Nyquist
+    for(SInt32 ix = -span; ix <= kmax + span; ++ix)
     {
-        copy_ftod(pin, m_ibuf()+m_ioff*hblksize+m_iscrap, nel);
-        
-        // we are the half block filled starting at the half-block index m_ioff
-		m_parent->render_samples(m_ibuf(), data, this); // results in data
-		m_obuf->put(data+qblksize, hblksize);
-        transfer_results_to_output(pout, nel, replace);
-		
-		pin   += nel;
-		pout  += nel;
-		nsamp -= nel;
-		m_iscrap = 0;
-		nel = hblksize;
-		incrmod(m_ioff, 1, 3);
+        SInt32 cell = (ix < 0) ? -ix : ix;
+        if(cell > hblk)
+            cell = 2*hblk - cell;
+        if(0 == cell)
+            get_FT_DC(pwr_spectrum, re);
+        else if(cell < 128 && cell < hblk)
+            get_FT_cell(pwr_spectrum, cell, re, im);
+        else
+            re = 0.0;
+        gpad[ix + span] = re;
     }
-	if(nsamp > 0)
+    
+    Float64 w0 = m_KernelWeight[0];
+    for(SInt32 ix = 0; ix <= kmax; ++ix)
     {
-		copy_ftod(pin, m_ibuf()+m_ioff*hblksize+m_iscrap, nsamp);
-		m_iscrap += nsamp;
-        transfer_results_to_output(pout, nsamp, replace);
+        Float64 *pg = gpad + ix + span;
+        Float64  acc = w0 * pg[0];
+        for(UInt32 jx = 1; jx < m_KernelTaps; ++jx)
+        {
+            SInt32 off = m_KernelOffset[jx];
+            acc += m_KernelWeight[jx] * (pg[-off] + pg[off]);
+        }
+        if(0 == ix)
+            set_FT_DC(filter, acc);
+        else if(ix < hblk)
+            set_FT_cell(filter, ix, acc, 0.0);
+        else
+            set_FT_Nyquist(filter, acc);
     }
+    for(SInt32 ix = kmax+1; ix < hblk; ++ix)
+        set_FT_cell(filter, ix, 0.0, 0.0);
+    if(kmax < hblk)
+        set_FT_Nyquist(filter, 0.0);
 }
 
-// -------------------------------------------------------------------------------------
-
-TCrescendo_bark_channel::TCrescendo_bark_channel(TCrescendo *parent)
+void TCrescendo::compute_filters_lanes(bark_lanes *lw)
 {
-    int ix;
-#if 0
-    // ----------------------------------
-    fprintf(stderr,"Initialize for sample rate: %F\n", sampleRate);
-    fflush(stderr);
-    // ----------------------------------
-#endif
+    // compute_ft_gains() and compute_filter() for the channels in
+    // lw->chan side by side, from the Bark gains in lw->gain. The interpolation to
+    // cells, the dB conversion and, for SpectralFilter, the smoothing
+    // go across the channels, with the same indices and weights in
+    // every lane. The reference filter's two transforms are per channel.
+    const TBarkTables *tbl = m_BarkTables;
+    const UInt32 L = VD_LANES;
+    Float64 *bg   = lw->gain;
+    Float64 *cell = lw->cell_gain;
+    Float64  gains[VD_LANES][128 + 64];
+    Float64 *cols[VD_LANES];
+    UInt32   c;
     
-    m_parent = parent;
-    m_blksize = 0;
+    for(c = 0; c < L; ++c)
+        cols[c] = lw->chan[c] ? gains[c] : 0;
     
-    for(ix = NSUBBANDS*NFBANDS+1; --ix >= 0;)
+    vd_store(cell, vd_add(vd_load(bg), vd_splat(m_UnifiedEQ[0])));
+    for(UInt32 ix = 1; ix < 128; ++ix)
+    {
+        UInt32  jx = tbl->ixbk[ix];
+        Float64 fx = tbl->fxbk[ix];
+        TVecD   g  = vd_add(vd_mul(vd_splat(1.0 - fx), vd_load(bg + jx*L)),
+                            vd_mul(vd_splat(fx), vd_load(bg + (jx+1)*L)));
+        vd_store(cell + ix*L, vd_add(g, vd_splat(m_UnifiedEQ[ix])));
+    }
+    if(get_FastDBMath())
+        vampl20(cell, cell, 128*L);
+    else
     {
-        m_bark[ix].holdctr  = 0;
-        m_bark[ix].prev_pwr = -140.0;
-        m_bark[ix].mean_pwr = -140.0;
-        m_bark[ix].release  = get_ReleaseFast();
-        m_bark[ix].prev_gain = 0.0;
+        for(UInt32 ix = 0; ix < 128*L; ++ix)
+            cell[ix] = ampl20(cell[ix]);
     }
     
-    set_vtuning(0.0);
+    if(!m_SpectralFilter)
+    {
+        vd_deinterleave(cell, cols, 128);
+        for(c = 0; c < L; ++c)
+        {
+            TCrescendo_bark_channel *chan = lw->chan[c];
+            if(!chan)
+                continue;
+            Float64 *pwr_spectrum = chan->get_PowerSpectrum();
+            set_real_gains(pwr_spectrum, gains[c], 128);
+            truncate_filter(chan, pwr_spectrum, chan->get_Filter());
+        }
+        return;
+    }
     
-    // m_limit is max permissible output amplitude
-    // Since worst case is 2 consecutive large, equal amplitude, spikes
-    // with center amplitude at 4/pi * amplitude of spikes,
-    // we should limit max amplitude to less than pi/4 = 0.785 = -2.1 dBFS
-    //
-    // UPDATE: Research into DAC behavior shows that worst case overshoot/clipping
-    // will occur when all the FIR taps abs values add up, in the output
-    // interpolation filters. Suggested range of max overshoot is 2.9-5.7dB.
-    //
-    // Since we can't know how good or bad our filters are,
-    // let's try to keep things below -6 dBFS = 0.5.
+    // see compute_filter_spectral(), the gains are real
+    SInt32   span = m_KernelSpan;
+    SInt32   hblk = m_hblksize;
+    SInt32   kmax = min(hblk, 127 + span);
+    Float64 *gpad = lw->gpad;
+    Float64 *filt = lw->filter;
     
-    m_level = 0.0;
+    for(SInt32 ix = -span; ix <= kmax + span; ++ix)
+    {
+        SInt32 cl = (ix < 0) ? -ix : ix;
+        if(cl > hblk)
+            cl = 2*hblk - cl;
+        TVecD g = vd_splat(0.0);
+        if(cl < 128 && cl < hblk)
+            g = vd_load(cell + cl*L);
+        vd_store(gpad + (ix + span)*L, g);
+    }
     
-    // 4th order 500 Hz Butterworth HPF, 48 kHz Fsamp
-    static Float64 cfilt_coffs1[5] = {
-        0.974538047066236,
-        -1.949076094132472,
-        0.974538047066236,
-        1.9469872972295479,
-        -0.9511648910353966};
-    static Float64 cfilt_coffs2[5] = {
-        0.9420089366880302,
-        -1.8840178733760605,
-        0.9420089366880302,
-        1.8819987984354725,
-        -0.8860369483166486};
-    m_crestFilter = new TOrd4Filter(cfilt_coffs1, cfilt_coffs2);
+    TVecD w0 = vd_splat(m_KernelWeight[0]);
+    for(SInt32 ix = 0; ix <= kmax; ++ix)
+    {
+        Float64 *pg  = gpad + (ix + span)*L;
+        TVecD    acc = vd_mul(w0, vd_load(pg));
+        for(UInt32 jx = 1; jx < m_KernelTaps; ++jx)
+        {
+            SInt32 off = m_KernelOffset[jx]*L;
+            acc = vd_add(acc, vd_mul(vd_splat(m_KernelWeight[jx]),
+                                     vd_add(vd_load(pg - off), vd_load(pg + off))));
+        }
+        vd_store(filt + ix*L, acc);
+    }
+    
+    // real, up to kmax, where the Nyquist cell may be
+    vd_deinterleave(filt, cols, kmax + 1);
+    for(c = 0; c < L; ++c)
+        if(lw->chan[c])
+            set_real_gains(lw->chan[c]->get_Filter(), gains[c], kmax + 1);
 }
 
-TCrescendo_bark_channel::~TCrescendo_bark_channel()
-{}
-
-//-------------------------------------------------------------------
-//
-void TCrescendo_bark_channel::SetSampleRate(Float64 sampleRate)
+void TCrescendo::init_filter_kernel()
 {
-#if 0
-	// ----------------------------------
-	fprintf(stderr,"Setting sample rate: %F\n", sampleRate);
+    // Find the transform of the truncation window by passing a unit
+    // DC gain through the reference construction. That keeps the scaling
+    // and spectrum layout of whichever FFT we have. The kernel is real
+    // and even, with zeros at every other even offset beyond 2, and its
+    // odd taps fall off as 1/k^3. Keep taps in order of offset until
+    // the discarded ones sum to less than SPECTRAL_FILTER_TOL of the
+    // kernel's DC response. That sum bounds the deviation from the
+    // reference filter, relative to the peak gain.
+    std::vector<Float64> gains(m_blksize, 0.0);
+    std::vector<Float64> kern(m_blksize, 0.0);
+    Float64  re, im;
+    UInt32   ix;
+    
+    set_FT_DC(&gains[0], 1.0);
+    truncate_filter(&m_Work, &gains[0], &kern[0]);
+    
+    Float64 *wk = &gains[0];   // reuse as |kernel| table, cells 0..h
+    Float64  sum, tail;
+    get_FT_DC(&kern[0], re);
+    wk[0] = re;
+    sum   = re;
+    tail  = 0.0;
+    for(ix = 1; ix < m_hblksize; ++ix)
+    {
+        get_FT_cell(&kern[0], ix, re, im);
+        wk[ix] = re;
+        sum  += 2.0*re;
+        tail += 2.0*fabs(re);
+    }
+    get_FT_Nyquist(&kern[0], re);
+    wk[m_hblksize] = re;
+    sum  += re;
+    tail += fabs(re);
+    
+    m_KernelOffset[0] = 0;
+    m_KernelWeight[0] = wk[0];
+    m_KernelTaps = 1;
+    m_KernelSpan = 0;
+    for(ix = 1; ix < m_hblksize && ix <= 64 && m_KernelTaps < 64; ++ix)
+    {
+        if(tail <= SPECTRAL_FILTER_TOL * fabs(sum))
+            break;
+        if(fabs(wk[ix]) > 1.0e-12 * fabs(wk[0]))
+        {
+            m_KernelOffset[m_KernelTaps] = ix;
+            m_KernelWeight[m_KernelTaps] = wk[ix];
+            ++m_KernelTaps;
+            m_KernelSpan = ix;
+        }
+        tail -= 2.0*fabs(wk[ix]);
+    }
+    m_FilterDeviation = max(0.0, tail) / fabs(sum);
+}
+
+Float64 TCrescendo::measure_float_analysis(Float64 *seg)
+{
+    // Band powers of one power estimation segment, m_blksize samples,
+    // through the double and the single precision transforms. Returns
+    // their largest difference in dB over the bands within 120 dB of
+    // the total. Uses the left channel's transform, so call this between
+    // renderings.
+    std::vector<Float64> spec(m_blksize);
+    std::vector<Float32> specF(m_blksize);
+    Float64  ref[128];
+    Float64  fast[128];
+    ipp_fft *fft = m_chans[0]->get_FFT();
+    
+    fft->fwd_windowed(seg, m_DataWindow(), &spec[0], 128);
+    fft->fwd_windowed(seg, m_DataWindow(), &specF[0], 128);
+    Float64 total = compute_bark_powers(&spec[0], ref);
+    compute_bark_powers(&specF[0], fast);
+    
+    Float64 dev = 0.0;
+    for(UInt32 ix = 0; ix < NSUBBANDS*NFBANDS; ++ix)
+    {
+        if(ref[ix] > 1e-12 * total)
+            dev = max(dev, fabs(db10(fast[ix]) - db10(ref[ix])));
+    }
+    return dev;
+}
+
+Float64 TCrescendo::measure_vector_gains()
+{
+    // see TCrescendo_bark_channel::measure_vector_gains(), call
+    // between renderings
+    Float64 dev = 0.0;
+    for(UInt32 ix = 0; ix < m_nchans; ++ix)
+        dev = max(dev, m_chans[ix]->measure_vector_gains());
+    return dev;
+}
+
+Float64 TCrescendo::measure_filter_deviation()
+{
+    // Compare both filter constructions on the left channel's current
+    // Bark gains. Uses the calibration workspace, so call this between
+    // renderings, not during one.
+    std::vector<Float64> ref(m_blksize);
+    std::vector<Float64> spec(m_blksize);
+    Float64  rre, rim, sre, sim;
+    
+    memcpy(m_Work.get_BarkGains(), m_chans[0]->get_BarkGains(), sizeof(Float64)*128);
+    compute_filter_reference(&m_Work, &ref[0]);
+    compute_filter_spectral(&m_Work, &spec[0]);
+    
+    get_FT_DC(&ref[0], rre);
+    get_FT_DC(&spec[0], sre);
+    Float64 pk  = fabs(rre);
+    Float64 dev = fabs(rre - sre);
+    for(UInt32 ix = 1; ix < m_hblksize; ++ix)
+    {
+        get_FT_cell(&ref[0], ix, rre, rim);
+        get_FT_cell(&spec[0], ix, sre, sim);
+        pk  = max(pk, sqrt(rre*rre + rim*rim));
+        dev = max(dev, sqrt((rre-sre)*(rre-sre) + (rim-sim)*(rim-sim)));
+    }
+    get_FT_Nyquist(&ref[0], rre);
+    get_FT_Nyquist(&spec[0], sre);
+    dev = max(dev, fabs(rre - sre));
+    return (pk > 0.0 ? dev / pk : dev);
+}
+
+//-------------------------------------------------------------------
+
+void TCrescendo::render_samples_wola(Float64 *pin, TCrescendo_bark_channel *chan)
+{
+    // Short-time Fourier transform with sine analysis and synthesis windows
+    // at 50% overlap. The power spectrum doubles as the signal spectrum, so
+    // there is one forward and one inverse FFT per hop.
+    //
+    // The gains are smoothed by the spectral filter kernel, which limits
+    // their impulse response to +/- 1/4 block. What little time-aliasing
+    // remains lands at the frame edges, where the synthesis window is small.
+    Float64 *data = chan->get_Data();
+    Float64 *pwin = m_SineWindow();
+    ipp_fft *fft  = chan->get_FFT();
+    
+    Float64 *seg  = chan->power_segment(pin, m_hblksize);
+    
+    // no ReuseDataFFT cache is kept up here, see render_samples()
+    chan->invalidate_spectra();
+    
+    chan->compute_crest_factor(seg + m_qblksize, m_hblksize);
+    fft->fwd_windowed(seg, pwin, data, m_hblksize);
+    
+    update_bark_powers(chan, data);
+    chan->compute_bark_gains();
+    compute_filter_spectral(chan, chan->get_Filter());
+    
+    fft->mulSpec(chan->get_Filter(), data, data);
+    fft->inv(data);
+    overlap_add(data, chan);
+}
+
+void TCrescendo::overlap_add(Float64 *data, TCrescendo_bark_channel *chan)
+{
+    Float64 *pwin = m_SineWindow();
+    Float64 *olap = chan->get_Overlap();
+    
+    dmul3(pwin, data, data, (int)m_blksize);
+    
+    // first half completes the previous frame, second half waits for the next
+    nspdbAdd2(olap, data, (int)m_hblksize);
+    dcopy(data+m_hblksize, olap, m_hblksize);
+}
+
+void TCrescendo::render_samples_stereo(Float64 *pinL, Float64 *pinR,
+                                       TCrescendo_bark_channel *lchan,
+                                       TCrescendo_bark_channel *rchan)
+{
+    // Both channels at once, with every transform shared between them
+    // by fwd2() and inv2() from the left channel's workspace. The analysis
+    // in between runs per channel, each in its own workspace, unless
+    // m_StereoLink. Then both band power estimates go to the left channel,
+    // and its gains and filter serve both.
+    Float64 *dataL = lchan->get_Data();
+    Float64 *dataR = rchan->get_Data();
+    ipp_fft *fft   = lchan->get_FFT();
+    
+    // no ReuseDataFFT cache is kept up here, see render_samples()
+    lchan->invalidate_spectra();
+    rchan->invalidate_spectra();
+    
+    if(m_WOLA)
+    {
+        Float64 *pwin = m_SineWindow();
+        
+        Float64 *segL = lchan->power_segment(pinL, m_hblksize);
+        Float64 *segR = rchan->power_segment(pinR, m_hblksize);
+        
+        // the window product is the copy for the in-place pair transform
+        lchan->compute_crest_factor(segL + m_qblksize, m_hblksize);
+        rchan->compute_crest_factor(segR + m_qblksize, m_hblksize);
+        dmul3(pwin, segL, dataL, (int)m_blksize);
+        dmul3(pwin, segR, dataR, (int)m_blksize);
+        fft->fwd2(dataL, dataR);
+        
+        update_bark_powers(lchan, dataL);
+        update_bark_powers(rchan, dataR);
+        if(m_StereoLink)
+        {
+            lchan->link_bark_powers(rchan, m_StereoLink);
+            lchan->compute_bark_gains();
+            compute_filter_spectral(lchan, lchan->get_Filter());
+            fft->mulSpec(lchan->get_Filter(), dataL, dataL);
+            fft->mulSpec(lchan->get_Filter(), dataR, dataR);
+        }
+        else
+        {
+            lchan->compute_bark_gains();
+            compute_filter_spectral(lchan, lchan->get_Filter());
+            fft->mulSpec(lchan->get_Filter(), dataL, dataL);
+            
+            rchan->compute_bark_gains();
+            compute_filter_spectral(rchan, rchan->get_Filter());
+            fft->mulSpec(rchan->get_Filter(), dataR, dataR);
+        }
+        fft->inv2(dataL, dataR);
+        overlap_add(dataL, lchan);
+        overlap_add(dataR, rchan);
+        return;
+    }
+    
+    Float64 *pwrL = lchan->get_PowerSpectrum();
+    Float64 *pwrR = rchan->get_PowerSpectrum();
+    Float64 *pwin = m_DataWindow();
+    
+    Float64 *segL = lchan->power_segment(pinL, m_hblksize);
+    Float64 *segR = rchan->power_segment(pinR, m_hblksize);
+    
+    lchan->compute_crest_factor(segL + m_qblksize, m_hblksize);
+    rchan->compute_crest_factor(segR + m_qblksize, m_hblksize);
+    dmul3(pwin, segL, pwrL, (int)m_blksize);
+    dmul3(pwin, segR, pwrR, (int)m_blksize);
+    fft->fwd2(pwrL, pwrR);
+    
+    // fwd2() works in place, so these are still copied
+    dcopy(lchan->filter_segment(pinL, m_hblksize), dataL, m_blksize);
+    dcopy(rchan->filter_segment(pinR, m_hblksize), dataR, m_blksize);
+    fft->fwd2(dataL, dataR);
+    
+    update_bark_powers(lchan);
+    update_bark_powers(rchan);
+    if(m_StereoLink)
+    {
+        lchan->link_bark_powers(rchan, m_StereoLink);
+        lchan->compute_bark_gains();
+        compute_filter(lchan);
+        fft->mulSpec(lchan->get_Filter(), dataL, dataL);
+        fft->mulSpec(lchan->get_Filter(), dataR, dataR);
+    }
+    else
+    {
+        lchan->compute_bark_gains();
+        compute_filter(lchan);
+        fft->mulSpec(lchan->get_Filter(), dataL, dataL);
+        
+        rchan->compute_bark_gains();
+        compute_filter(rchan);
+        fft->mulSpec(rchan->get_Filter(), dataR, dataR);
+    }
+    fft->inv2(dataL, dataR);
+}
+
+void TCrescendo::render_samples_fanout(Float64 *pin, TCrescendo_bark_channel *src,
+                                       TCrescendo **profiles, UInt32 nprof)
+{
+    // The feed's transforms and crest factor, once, in the source's
+    // workspace. Then for each profile, in the workspace of its first
+    // channel, the band powers, gains, filter and inverse transform.
+    // The band powers are weighted by the profile's EQ, so they are
+    // measured once per distinct EQ and copied to the rest.
+    Float64 *spec = src->get_Data();
+    Float64 *seg  = src->power_segment(pin, m_hblksize);
+    Float64  total[CRESCENDO_MAX_PROFILES];
+    
+    // nor here, see render_samples()
+    src->invalidate_spectra();
+    
+    if(m_WOLA)
+    {
+        src->compute_crest_factor(seg + m_qblksize, m_hblksize);
+        src->get_FFT()->fwd_windowed(seg, m_SineWindow(), spec, m_hblksize);
+    }
+    else
+    {
+        compute_power_spectrum(pin, src);
+        src->get_FFT()->fwd(src->filter_segment(pin, m_hblksize), spec);
+    }
+    
+    for(UInt32 ix = 0; ix < nprof; ++ix)
+    {
+        TCrescendo *prof = profiles[ix];
+        TCrescendo_bark_channel *chan = prof->m_chans[0]();
+        Float64 *bark = chan->get_BarkSpectrum();
+        Float64 *data = chan->get_Data();
+        ipp_fft *fft  = chan->get_FFT();
+        
+        chan->invalidate_spectra();
+        UInt32 jx;
+        for(jx = 0; jx < ix; ++jx)
+            if(profiles[jx]->m_UnifiedEQAmpl == prof->m_UnifiedEQAmpl)
+                break;
+        if(jx < ix)
+        {
+            dcopy(profiles[jx]->m_chans[0]->get_BarkSpectrum(), bark, NSUBBANDS*NFBANDS);
+            total[ix] = total[jx];
+        }
+        else if(m_WOLA)
+            total[ix] = db10(prof->compute_bark_powers(spec, bark)) - prof->get_selfCalSF();
+        else if(m_FloatAnalysis)
+            total[ix] = db10(prof->compute_bark_powers(src->get_PowerSpectrumF(), bark)) - prof->get_selfCalSF();
+        else
+            total[ix] = db10(prof->compute_bark_powers(src->get_PowerSpectrum(), bark)) - prof->get_selfCalSF();
+        chan->update_level(total[ix]);
+        chan->share_crest_factor(src);
+        
+        chan->compute_bark_gains();
+        if(m_WOLA)
+            prof->compute_filter_spectral(chan, chan->get_Filter());
+        else
+            prof->compute_filter(chan);
+        fft->mulSpec(chan->get_Filter(), spec, data);
+        fft->inv(data);
+        if(m_WOLA)
+            prof->overlap_add(data, chan);
+    }
+}
+
+void TCrescendo::render_samples(Float64 *pin, TCrescendo_bark_channel *chan)
+{
+    // results in chan->get_Data()
+    Float64 *data   = chan->get_Data();
+    Float64 *filter = chan->get_Filter();
+    ipp_fft *fft    = chan->get_FFT();
+    
+    if(m_WOLA)
+    {
+        render_samples_wola(pin, chan);
+        return;
+    }
+    if(m_ReuseDataFFT)
+    {
+        // The segment selected for filtering on this hop was the
+        // power estimation segment on the previous hop. Use its cached
+        // unwindowed spectrum and save one forward FFT per hop.
+        compute_reusable_spectrum(pin, chan->get_NextSpectrum(), chan);
+        update_bark_powers(chan);
+        chan->compute_bark_gains();
+        compute_filter(chan);
+        
+        Float64 *prev = chan->get_PrevSpectrum();
+        if(prev)
+            fft->mulSpec(filter, prev, data);
+        else
+        {
+            // first hop in this mode, nothing cached yet
+            fft->fwd(chan->filter_segment(pin, m_hblksize), data);
+            fft->mulSpec(filter, data, data);
+        }
+        fft->inv(data);
+        chan->rotate_spectra();
+        return;
+    }
+    chan->invalidate_spectra();
+    
+    update_filter(pin, chan);
+    
+    // non-windowed transform for data
+    // overlap-save convolution does not use data windowing
+    // 1/2 block delay from filter center = 2.67 ms at 48 kHz
+    fft->fwd(chan->filter_segment(pin, m_hblksize), data);
+    fft->mulSpec(filter, data, data);
+    fft->inv(data);
+}
+
+void TCrescendo::render_samples_lanes(bark_lanes *lw, Float64 **pin)
+{
+    // render_samples() for the channels in lw->chan, results in each
+    // channel's get_Data(). The band powers, the gains and the cell
+    // gains go across the channels in vector lanes. The transforms and
+    // the spectrum multiply stay per channel, they are vectorized across
+    // cells already and interleaving the spectra would only add shuffles.
+    UInt32 c;
+    
+    for(c = 0; c < VD_LANES; ++c)
+    {
+        TCrescendo_bark_channel *chan = lw->chan[c];
+        if(chan)
+        {
+            chan->invalidate_spectra();
+            compute_power_spectrum(pin[c], chan);
+        }
+    }
+    compute_bark_powers_lanes(lw);
+    TCrescendo_bark_channel::compute_bark_gains_lanes(lw);
+    compute_filters_lanes(lw);
+    
+    for(c = 0; c < VD_LANES; ++c)
+    {
+        TCrescendo_bark_channel *chan = lw->chan[c];
+        if(!chan)
+            continue;
+        Float64 *data = chan->get_Data();
+        ipp_fft *fft  = chan->get_FFT();
+        
+        fft->fwd(chan->filter_segment(pin[c], m_hblksize), data);
+        fft->mulSpec(chan->get_Filter(), data, data);
+        fft->inv(data);
+    }
+}
+
+// -------------------------------------------------------------------------------------
+
+void TCrescendo_bark_channel::transfer_results_to_output(Float32* pout, UInt32 nel, bool replace)
+{
+    // straight out of the output buffer, at most two spans
+    while(nel > 0)
+    {
+        Float64 *psrc;
+        UInt32   n = m_obuf->get_span(psrc, nel);
+        emit_output(psrc, pout, n, replace);
+        pout += n;
+        nel  -= n;
+    }
+}
+
+void TCrescendo_bark_channel::emit_output(Float64 *psrc, Float32 *pout, UInt32 nel, bool replace)
+{
+    if(replace)
+        m_OutDither.copy_dtos_with_dither(psrc, pout, nel);
+    else
+        m_OutDither.accum_dtos_with_dither(psrc, pout, nel);
+}
+
+static inline bool disjoint(const Float32 *a, const Float32 *b, UInt32 nel)
+{
+    return (a + nel <= b) || (b + nel <= a);
+}
+
+void TCrescendo_bark_channel::save_input(Float32 *pin, UInt32 nel)
+{
+    // at m_iscrap into half block m_ioff, and again into its mirror
+    // when that is half block 0
+    UInt32   hblksize = get_hblksize();
+    Float64 *dst = m_ibuf() + m_ioff*hblksize + m_iscrap;
+    
+    copy_ftod(pin, dst, nel);
+    if(0 == m_ioff)
+        dcopy(dst, dst + 3*hblksize, nel);
+}
+
+void TCrescendo_bark_channel::render_channel(Float32 *pin,
+                                             Float32 *pout,
+                                             UInt32   nsamp,
+                                             bool     replace)
+{
+#if 0
+	FILE *fp = fopen("/Users/david/Crescendo/MacAudio/cresc_log.txt", "a");
+	fprintf(fp, "nsamp = %d\n", nsamp);
+	fprintf(fp, "pin = %p\n", pin);
+	fprintf(fp, "pout = %p\n", pout);
+	fclose(fp);
+#endif
+	Float64 *data = get_Data();
+	int      hblksize = get_hblksize();
+    int      ooff = m_parent->get_output_offset();
+	UInt32   nel  = hblksize - m_iscrap;
+    
+    if(0 == m_iscrap && nsamp >= nel && 0 == nsamp % hblksize &&
+       disjoint(pin, pout, nsamp))
+    {
+        render_aligned(pin, pout, nsamp, replace);
+        return;
+    }
+	while(nsamp >= nel)
+    {
+        save_input(pin, nel);
+        
+        // we are the half block filled starting at the half-block index m_ioff
+		m_parent->render_samples(m_ibuf(), this); // results in data
+		m_obuf->put(data+ooff, hblksize);
+        transfer_results_to_output(pout, nel, replace);
+		
+		pin   += nel;
+		pout  += nel;
+		nsamp -= nel;
+		m_iscrap = 0;
+		nel = hblksize;
+		incrmod(m_ioff, 1, 3);
+    }
+	if(nsamp > 0)
+    {
+		save_input(pin, nsamp);
+		m_iscrap += nsamp;
+        transfer_results_to_output(pout, nsamp, replace);
+    }
+}
+
+void TCrescendo_bark_channel::render_channel_pair(TCrescendo_bark_channel *right,
+                                                  Float32 *pinL, Float32 *pinR,
+                                                  Float32 *poutL, Float32 *poutR,
+                                                  UInt32   nsamp,
+                                                  bool     replace)
+{
+    // render_channel() for this channel and its right-hand partner in
+    // lockstep, so that each hop transforms both at once.
+    // Caller ensures in_step_with(right).
+	Float64 *dataL = get_Data();
+	Float64 *dataR = right->get_Data();
+	int      hblksize = get_hblksize();
+    int      ooff = m_parent->get_output_offset();
+	UInt32   nel  = hblksize - m_iscrap;
+    
+    if(0 == m_iscrap && nsamp >= nel && 0 == nsamp % hblksize &&
+       disjoint(pinL, poutL, nsamp) && disjoint(pinL, poutR, nsamp) &&
+       disjoint(pinR, poutL, nsamp) && disjoint(pinR, poutR, nsamp))
+    {
+        render_aligned_pair(right, pinL, pinR, poutL, poutR, nsamp, replace);
+        return;
+    }
+	while(nsamp >= nel)
+    {
+        save_input(pinL, nel);
+        right->save_input(pinR, nel);
+        
+		m_parent->render_samples_stereo(m_ibuf(), right->m_ibuf(), this, right);
+		m_obuf->put(dataL+ooff, hblksize);
+		right->m_obuf->put(dataR+ooff, hblksize);
+        transfer_results_to_output(poutL, nel, replace);
+        right->transfer_results_to_output(poutR, nel, replace);
+		
+		pinL  += nel;
+		pinR  += nel;
+		poutL += nel;
+		poutR += nel;
+		nsamp -= nel;
+		m_iscrap = right->m_iscrap = 0;
+		nel = hblksize;
+		incrmod(m_ioff, 1, 3);
+		right->m_ioff = m_ioff;
+    }
+	if(nsamp > 0)
+    {
+		save_input(pinL, nsamp);
+		right->save_input(pinR, nsamp);
+		m_iscrap += nsamp;
+		right->m_iscrap = m_iscrap;
+        transfer_results_to_output(poutL, nsamp, replace);
+        right->transfer_results_to_output(poutR, nsamp, replace);
+    }
+}
+
+void TCrescendo_bark_channel::render_channel_lanes(bark_lanes *lw,
+                                                   Float32 **pin, Float32 **pout,
+                                                   UInt32   nsamp,
+                                                   bool     replace)
+{
+    // render_channel_pair() for the channels in lw->chan. All of them
+    // save their input before any of them writes output, so a channel
+    // rendered in place cannot feed another.
+    // Caller ensures they are in step and on the same tuning.
+    TCrescendo_bark_channel *lead = 0;
+    Float64 *ibuf[VD_LANES];
+    Float32 *pi[VD_LANES];
+    Float32 *po[VD_LANES];
+    UInt32   c;
+    
+    for(c = 0; c < VD_LANES; ++c)
+    {
+        TCrescendo_bark_channel *chan = lw->chan[c];
+        ibuf[c] = 0;
+        if(!chan)
+            continue;
+        if(!lead)
+            lead = chan;
+        ibuf[c] = chan->m_ibuf();
+        pi[c] = pin[c];
+        po[c] = pout[c];
+    }
+    TCrescendo *parent = lead->m_parent;
+    int      hblksize = lead->get_hblksize();
+    int      ooff = parent->get_output_offset();
+    UInt32   nel  = hblksize - lead->m_iscrap;
+    
+    while(nsamp >= nel)
+    {
+        for(c = 0; c < VD_LANES; ++c)
+            if(lw->chan[c])
+                lw->chan[c]->save_input(pi[c], nel);
+        
+        parent->render_samples_lanes(lw, ibuf);
+        for(c = 0; c < VD_LANES; ++c)
+        {
+            TCrescendo_bark_channel *chan = lw->chan[c];
+            if(!chan)
+                continue;
+            chan->m_obuf->put(chan->get_Data()+ooff, hblksize);
+            chan->transfer_results_to_output(po[c], nel, replace);
+            pi[c] += nel;
+            po[c] += nel;
+            chan->m_iscrap = 0;
+            incrmod(chan->m_ioff, 1, 3);
+        }
+        nsamp -= nel;
+        nel = hblksize;
+    }
+    if(nsamp > 0)
+    {
+        for(c = 0; c < VD_LANES; ++c)
+        {
+            if(lw->chan[c])
+            {
+                lw->chan[c]->save_input(pi[c], nsamp);
+                lw->chan[c]->m_iscrap += nsamp;
+            }
+        }
+        for(c = 0; c < VD_LANES; ++c)
+            if(lw->chan[c])
+                lw->chan[c]->transfer_results_to_output(po[c], nsamp, replace);
+    }
+}
+
+void TCrescendo_bark_channel::render_aligned(Float32 *pin,
+                                             Float32 *pout,
+                                             UInt32   nsamp,
+                                             bool     replace)
+{
+    // render_channel() for a call on a hop boundary, whole hops long,
+    // with pin and pout apart. Each hop's output is due one hop later,
+    // so it goes straight into pout at the next hop. The first hop out
+    // is what the previous call left in m_obuf, the last hop is left
+    // there for the next call.
+	Float64 *data = get_Data();
+	UInt32   hblksize = get_hblksize();
+    int      ooff = m_parent->get_output_offset();
+    
+    transfer_results_to_output(pout, hblksize, replace);
+    for(;;)
+    {
+        save_input(pin, hblksize);
+		m_parent->render_samples(m_ibuf(), this); // results in data
+		incrmod(m_ioff, 1, 3);
+        
+		pin   += hblksize;
+		pout  += hblksize;
+		nsamp -= hblksize;
+        if(0 == nsamp)
+            break;
+        emit_output(data+ooff, pout, hblksize, replace);
+    }
+    m_obuf->put(data+ooff, hblksize);
+}
+
+void TCrescendo_bark_channel::render_aligned_pair(TCrescendo_bark_channel *right,
+                                                  Float32 *pinL, Float32 *pinR,
+                                                  Float32 *poutL, Float32 *poutR,
+                                                  UInt32   nsamp,
+                                                  bool     replace)
+{
+    // render_aligned() for both channels in lockstep
+	Float64 *dataL = get_Data();
+	Float64 *dataR = right->get_Data();
+	UInt32   hblksize = get_hblksize();
+    int      ooff = m_parent->get_output_offset();
+    
+    transfer_results_to_output(poutL, hblksize, replace);
+    right->transfer_results_to_output(poutR, hblksize, replace);
+    for(;;)
+    {
+        save_input(pinL, hblksize);
+        right->save_input(pinR, hblksize);
+		m_parent->render_samples_stereo(m_ibuf(), right->m_ibuf(), this, right);
+		incrmod(m_ioff, 1, 3);
+		right->m_ioff = m_ioff;
+        
+		pinL  += hblksize;
+		pinR  += hblksize;
+		poutL += hblksize;
+		poutR += hblksize;
+		nsamp -= hblksize;
+        if(0 == nsamp)
+            break;
+        emit_output(dataL+ooff, poutL, hblksize, replace);
+        right->emit_output(dataR+ooff, poutR, hblksize, replace);
+    }
+    m_obuf->put(dataL+ooff, hblksize);
+    right->m_obuf->put(dataR+ooff, hblksize);
+}
+
+void TCrescendo_bark_channel::render_channel_fanout(TCrescendo **profiles, UInt32 nprof,
+                                                    Float32 *pin, Float32 **pout,
+                                                    UInt32   nsamp,
+                                                    bool     replace)
+{
+    // render_channel() with the input history here and the output
+    // buffers in channel 0 of each profile
+	int      hblksize = get_hblksize();
+    int      ooff = m_parent->get_output_offset();
+	UInt32   nel  = hblksize - m_iscrap;
+    UInt32   done = 0;
+    
+	while(nsamp >= nel)
+    {
+        save_input(pin + done, nel);
+        
+		m_parent->render_samples_fanout(m_ibuf(), this, profiles, nprof);
+        for(UInt32 ix = 0; ix < nprof; ++ix)
+        {
+            TCrescendo_bark_channel *chan = profiles[ix]->get_channel(0);
+            chan->m_obuf->put(chan->get_Data()+ooff, hblksize);
+            chan->transfer_results_to_output(pout[ix] + done, nel, replace);
+        }
+		
+		done  += nel;
+		nsamp -= nel;
+		m_iscrap = 0;
+		nel = hblksize;
+		incrmod(m_ioff, 1, 3);
+    }
+	if(nsamp > 0)
+    {
+		save_input(pin + done, nsamp);
+		m_iscrap += nsamp;
+        for(UInt32 ix = 0; ix < nprof; ++ix)
+            profiles[ix]->get_channel(0)->transfer_results_to_output(pout[ix] + done, nsamp, replace);
+    }
+}
+
+// -------------------------------------------------------------------------------------
+
+TCrescendo_bark_channel::TCrescendo_bark_channel(TCrescendo *parent)
+{
+    int ix;
+#if 0
+    // ----------------------------------
+    fprintf(stderr,"Initialize for sample rate: %F\n", sampleRate);
+    fflush(stderr);
+    // ----------------------------------
+#endif
+    
+    m_parent = parent;
+    m_blksize = 0;
+    m_PrevSpec = 0;
+    m_NextSpec = 0;
+    m_PrevSpecValid = false;
+    
+    m_LaneHome      = 0;
+    m_Lane          = 0;
+    m_bandsSerial   = 0;
+    m_BuildTables   = 0;
+    m_ActiveTables  = 0;
+    m_TableHops     = 0;
+    m_PublishedTables.store(0);
+    
+    for(ix = NBARKS; --ix >= 0;)
+    {
+        m_bands.holdctr[ix]  = 0.0;
+        m_bands.prev_pwr[ix] = -140.0;
+        m_bands.mean_pwr[ix] = -140.0;
+        m_bands.release[ix]  = get_ReleaseFast();
+        m_bands.prev_gain[ix] = 0.0;
+        
+        // dBHL conversions, as in dbfs_to_dbhl() and gdbhl_to_gdbspl()
+        Float64 fletch = gFletch[ix];
+        if(fletch < 0.0)
+        {
+            m_bands.hl_div[ix]  = 1.0 + fletch / 240.0;
+            m_bands.spl_mul[ix] = 1.0 + fletch / 240.0;
+        }
+        else
+        {
+            m_bands.hl_div[ix]  = (fletch < 120.0) ? 1.0 - fletch / 120.0 : 1.0;
+            m_bands.spl_mul[ix] = 1.0 - fletch / 120.0;
+        }
+    }
+    
+    set_vtuning(0.0);
+    
+    // m_limit is max permissible output amplitude
+    // Since worst case is 2 consecutive large, equal amplitude, spikes
+    // with center amplitude at 4/pi * amplitude of spikes,
+    // we should limit max amplitude to less than pi/4 = 0.785 = -2.1 dBFS
+    //
+    // UPDATE: Research into DAC behavior shows that worst case overshoot/clipping
+    // will occur when all the FIR taps abs values add up, in the output
+    // interpolation filters. Suggested range of max overshoot is 2.9-5.7dB.
+    //
+    // Since we can't know how good or bad our filters are,
+    // let's try to keep things below -6 dBFS = 0.5.
+    
+    m_level = 0.0;
+    
+    // 4th order 500 Hz Butterworth HPF, 48 kHz Fsamp
+    static Float64 cfilt_coffs1[5] = {
+        0.974538047066236,
+        -1.949076094132472,
+        0.974538047066236,
+        1.9469872972295479,
+        -0.9511648910353966};
+    static Float64 cfilt_coffs2[5] = {
+        0.9420089366880302,
+        -1.8840178733760605,
+        0.9420089366880302,
+        1.8819987984354725,
+        -0.8860369483166486};
+    m_crestFilter = new TOrd4Filter(cfilt_coffs1, cfilt_coffs2);
+}
+
+TCrescendo_bark_channel::~TCrescendo_bark_channel()
+{}
+
+//-------------------------------------------------------------------
+//
+void TCrescendo_bark_channel::SetSampleRate(Float64 sampleRate)
+{
+#if 0
+	// ----------------------------------
+	fprintf(stderr,"Setting sample rate: %F\n", sampleRate);
 	fflush(stderr);
 	// ----------------------------------
 #endif
@@ -596,11 +1888,38 @@ void TCrescendo_bark_channel::SetSampleRate(Float64 sampleRate)
         
 		m_ioff   = 0;
 		m_iscrap = 0;
-        m_ibuf.reallocz(3*hblksize);
+        m_ibuf.reallocz(4*hblksize);
+        
+        m_SpecCache.reallocz(2*m_blksize);
+        m_PrevSpec = m_SpecCache();
+        m_NextSpec = m_SpecCache() + m_blksize;
+        m_PrevSpecValid = false;
+        
+        m_Overlap.reallocz(hblksize);
+        alloc_workspace(m_parent->get_fftOrder());
 		
         m_obuf = new TCircbuf(2*hblksize);
 		m_obuf->put(m_ibuf(), hblksize);
     }
+    
+    UInt32 factor = m_parent->get_RateFactor();
+    if(factor > 1)
+        m_Resampler = new TResampler(factor, RESAMPLE_CHUNK);
+    else
+        m_Resampler.discard();
+}
+
+void TCrescendo_workspace::alloc_workspace(UInt32 fft_order)
+{
+    UInt32 blksize = (1 << fft_order);
+    
+    m_FFT.realloc();
+    m_FFT->init(fft_order, IPP_FFT_DIV_FWD_BY_N);
+    
+    m_PowerSpectrum.realloc(blksize);
+    m_PowerSpectrumF.realloc(blksize);
+    m_Filter.realloc(blksize);
+    m_Data.realloc(blksize);
 }
 
 //-------------------------------------------------------------------
@@ -618,13 +1937,39 @@ TCrescendo::TCrescendo(Float64 sampleRate)
     
 	m_Processing = true;
 	// m_CorrectionsOnly = false;
+    m_ReuseDataFFT = false;
+    m_SpectralFilter = false;
+    m_WOLA = false;
+    m_StereoFFT = false;
+    m_StereoLink = kStereoLinkOff;
+    m_ParallelChannels = false;
+    m_ChannelLanes = false;
+    m_Lanes = 0;
+    m_PlainRelax = false;
+    m_GainTables = false;
+    m_TableBuilder = 0;
+    m_VectorBarkGains = false;
+    m_FastDBMath = false;
+    m_FloatAnalysis = false;
+    m_ResampleHighRates = false;
+    m_RateFactor = 1;
+    m_hostRate = 0.0;
+    m_Worker   = 0;
+    m_AudioFFT = 0;
+    m_BarkTables = 0;
+    m_Unified    = 0;
+    for(int ix = 0; ix < kEQ_NParts; ++ix)
+        m_EQParts[ix] = 0;
 	
     m_blksize = 0;
     m_sampleRate = 0.0;
     m_vTuning = 0.0;
     
-	m_lchan = new TCrescendo_bark_channel(this);
-	m_rchan = new TCrescendo_bark_channel(this);
+    m_DitherSeeded = false;
+    m_DitherSeed   = 0;
+    m_nchans = 2;
+	m_chans[0] = new TCrescendo_bark_channel(this);
+	m_chans[1] = new TCrescendo_bark_channel(this);
     
     set_vtuning(20.0);
     m_HdphEQ_basis = &gNullEQ;
@@ -635,54 +1980,218 @@ TCrescendo::TCrescendo(Float64 sampleRate)
 }
 
 TCrescendo::~TCrescendo()
-{}
+{
+    delete m_Worker;
+    delete[] m_Lanes;
+    if(m_TableBuilder)
+        m_TableBuilder->wait();
+    delete m_TableBuilder;
+    TBarkTables::release(m_BarkTables);
+    TUnifiedEQ::release(m_Unified);
+    for(int ix = 0; ix < kEQ_NParts; ++ix)
+        TEQCurve::release(m_EQParts[ix]);
+}
 
 //-------------------------------------------------------------------
 //
 void TCrescendo::SetSampleRate(Float64 sampleRate)
 {
-    if(m_sampleRate != sampleRate)
+    UInt32 factor = core_rate_factor(sampleRate);
+    if(m_hostRate != sampleRate || m_RateFactor != factor)
     {
-        int blksize = (sampleRate > 50.0e3) ? 512 : 256;
-        m_sampleRate = sampleRate;
-        
-        if(blksize != m_blksize)
+        m_hostRate   = sampleRate;
+        m_RateFactor = factor;
+        set_core_rate(sampleRate / factor);
+    }
+}
+
+// power of two taking a high host rate down to 44.1 or 48 kHz, else 1
+
+UInt32 TCrescendo::core_rate_factor(Float64 sampleRate)
+{
+    if(m_ResampleHighRates)
+    {
+        for(UInt32 factor = 2; factor <= 8; factor <<= 1)
         {
-            m_blksize  = blksize;
-            m_hblksize = blksize >> 1;
-            m_qblksize = blksize >> 2;
-            
-            int fft_order = (sampleRate > 50.0e3) ?   9 :   8;
-            m_AudioFFT.realloc();
-            m_AudioFFT->init(fft_order, IPP_FFT_DIV_FWD_BY_N);
-            
-            init_datawin();
-            
-            m_PowerSpectrum.realloc(blksize);
-            m_Filter.realloc(blksize);
-            m_Data.realloc(blksize);
+            Float64 core = sampleRate / factor;
+            if(fabs(core - 44100.0) < 1.0 || fabs(core - 48000.0) < 1.0)
+                return factor;
         }
+    }
+    return 1;
+}
+
+void TCrescendo::set_core_rate(Float64 sampleRate)
+{
+    UInt32 blksize = (sampleRate > 50.0e3) ? 512 : 256;
+    m_sampleRate = sampleRate;
+    
+    if(blksize != m_blksize)
+    {
+        m_blksize  = blksize;
+        m_hblksize = blksize >> 1;
+        m_qblksize = blksize >> 2;
         
-        Float64 blk_sr = sampleRate / m_hblksize;
-        m_HoldCt       = (UInt32)ceil(10.0e-3 * blk_sr);
-        m_ReleaseSlow  = e_folding(200.0e-3, blk_sr);
-        m_ReleaseFast  = e_folding( 50.0e-3, blk_sr);
-        m_LevelAlpha   = e_folding(300.0e-3, blk_sr);
-        m_GainRelease  = e_folding( 10.0e-3, blk_sr);
-        
-        fill_bark_interpolation_tables();
-        
-        compute_inverse_ATH_filter();
-        set_preEQ();
-        set_postEQ(m_PostEQ_basis, true);
-        set_headphone(m_HdphEQ_basis, true);
-        ensure_unified_filter();
-        
-        m_lchan->SetSampleRate(sampleRate);
-        m_rchan->SetSampleRate(sampleRate);
+        m_fftOrder = (sampleRate > 50.0e3) ?   9 :   8;
+        m_Work.alloc_workspace(m_fftOrder);
+        m_AudioFFT = m_Work.get_FFT();
         
-        self_calibrate();
+        init_datawin();
+        init_filter_kernel();
+    }
+    
+    Float64 blk_sr = sampleRate / m_hblksize;
+    m_HoldCt       = (UInt32)ceil(10.0e-3 * blk_sr);
+    m_ReleaseSlow  = e_folding(200.0e-3, blk_sr);
+    m_ReleaseFast  = e_folding( 50.0e-3, blk_sr);
+    m_LevelAlpha   = e_folding(300.0e-3, blk_sr);
+    m_GainRelease  = e_folding( 10.0e-3, blk_sr);
+    
+    fill_bark_interpolation_tables();
+    
+    compute_inverse_ATH_filter();
+    set_preEQ();
+    set_postEQ(m_PostEQ_basis, true);
+    set_headphone(m_HdphEQ_basis, true);
+    ensure_unified_filter();
+    
+    for(UInt32 ix = 0; ix < m_nchans; ++ix)
+        m_chans[ix]->SetSampleRate(sampleRate);
+    
+    self_calibrate();
+}
+
+void TCrescendo::set_ResampleHighRates(bool arg)
+{
+    if(m_ResampleHighRates != arg)
+    {
+        m_ResampleHighRates = arg;
+        if(m_hostRate > 0.0)
+            SetSampleRate(m_hostRate);
+    }
+}
+
+void TCrescendo::set_WOLA(bool arg)
+{
+    if(m_WOLA != arg)
+    {
+        m_WOLA = arg;
+        m_selfCalSF = (arg ? m_selfCalSine : m_selfCalHann);
+        for(UInt32 ix = 0; ix < m_nchans; ++ix)
+            m_chans[ix]->reset_overlap();
+    }
+}
+
+void TCrescendo::set_DitherSeed(UInt32 seed)
+{
+    // channel ix on stream ix, and channels added later too
+    m_DitherSeeded = true;
+    m_DitherSeed   = seed;
+    for(UInt32 ix = 0; ix < m_nchans; ++ix)
+        m_chans[ix]->seed_dither(seed, ix);
+}
+
+void TCrescendo::set_NumChannels(UInt32 nchan)
+{
+    // call from the control thread, never while render() is running.
+    // Channels 0 and 1 always stay, for render().
+    nchan = min(max(nchan, UInt32(2)), UInt32(CRESCENDO_MAX_CHANNELS));
+    if(m_GainTables && m_TableBuilder)
+        m_TableBuilder->wait();
+    for(UInt32 ix = nchan; ix < m_nchans; ++ix)
+        m_chans[ix].discard();
+    for(UInt32 ix = m_nchans; ix < nchan; ++ix)
+    {
+        TCrescendo_bark_channel *chan = new TCrescendo_bark_channel(this);
+        chan->SetSampleRate(m_sampleRate);
+        chan->set_vtuning(m_vTuning);
+        chan->set_plain_relax(m_PlainRelax);
+        if(m_DitherSeeded)
+            chan->seed_dither(m_DitherSeed, ix);
+        m_chans[ix] = chan;
     }
+    m_nchans = nchan;
+}
+
+void TCrescendo::set_PlainRelax(bool arg)
+{
+    m_PlainRelax = (arg && DAZFZ_AVAILABLE);
+    for(UInt32 ix = 0; ix < m_nchans; ++ix)
+        m_chans[ix]->set_plain_relax(m_PlainRelax);
+}
+
+void TCrescendo::set_GainTables(bool arg)
+{
+    // call from the control thread, never while render() is running
+    m_GainTables = arg;
+    if(arg && !m_TableBuilder)
+    {
+        m_TableBuilder = new TWorker;
+        // give the first build its hops, and start it now rather than
+        // with the first render
+        for(UInt32 ix = 0; ix < m_nchans; ++ix)
+            m_chans[ix]->restart_gain_tables();
+        update_gain_tables();
+    }
+    else if(!arg && m_TableBuilder)
+    {
+        m_TableBuilder->wait();
+        delete m_TableBuilder;
+        m_TableBuilder = 0;
+    }
+}
+
+static void build_tables_job(void *arg)
+{
+    TCrescendo_bark_channel **chans = (TCrescendo_bark_channel**)arg;
+    for(; *chans; ++chans)
+        (*chans)->build_gain_tables();
+}
+
+void TCrescendo::update_gain_tables()
+{
+    // Called at the start of render(), once the parameters are in, so
+    // the build runs alongside the rendering. The channels only read
+    // published tables, and we only fill the unpublished ones, between
+    // renders. At most one build in flight. A vtune change during a
+    // build is picked up by the next one.
+    if(m_TableBuilder->busy())
+        return;
+    bool stale = false;
+    for(UInt32 ix = 0; ix < m_nchans; ++ix)
+        stale = stale || m_chans[ix]->gain_tables_stale();
+    if(stale)
+    {
+        for(UInt32 ix = 0; ix < m_nchans; ++ix)
+        {
+            m_TableJob[ix] = m_chans[ix]();
+            m_chans[ix]->prepare_gain_tables();
+        }
+        m_TableJob[m_nchans] = 0;
+        m_TableBuilder->post(build_tables_job, m_TableJob);
+    }
+}
+
+void TCrescendo::set_ParallelChannels(bool arg)
+{
+    // call from the control thread, never while render() is running
+    m_ParallelChannels = arg;
+    if(arg && !m_Worker)
+        m_Worker = new TWorker;
+    else if(!arg && m_Worker)
+    {
+        delete m_Worker;
+        m_Worker = 0;
+    }
+}
+
+void TCrescendo::set_ChannelLanes(bool arg)
+{
+    // call from the control thread, never while render() is running.
+    // The lane blocks are kept once made.
+    m_ChannelLanes = arg;
+    if(arg && !m_Lanes)
+        m_Lanes = new bark_lanes[(CRESCENDO_MAX_CHANNELS + VD_LANES - 1)/VD_LANES]();
 }
 
 void TCrescendo::set_vtuning(float vtune)
@@ -690,54 +2199,347 @@ void TCrescendo::set_vtuning(float vtune)
     if(m_vTuning != vtune)
     {
         m_vTuning = vtune;
-        m_lchan->set_vtuning(vtune);
-        m_rchan->set_vtuning(vtune);
+        for(UInt32 ix = 0; ix < m_nchans; ++ix)
+            m_chans[ix]->set_vtuning(vtune);
     }
 }
 
+static void render_job(void *arg)
+{
+    tChannelJob *job = (tChannelJob*)arg;
+    job->self->render_range(job->pin, job->pout, job->first, job->last,
+                            job->nel, job->replace);
+}
+
+void TCrescendo::apply_params(tVTuningParams *parms)
+{
+    set_CaldBFS(parms->CaldBFS);
+    set_CaldBSPL(parms->CaldBSPL);
+    set_vtuning(parms->vTune);
+    set_Processing(parms->proc_onoff);
+    // set_CorrectionsOnly(parms->corr_only_onoff);
+    set_VoldB(parms->voldB);
+    set_AttendB(parms->attendB);
+    // set_Brightness(parms->brighnessdB);
+    set_postEQ(parms->postEQ);
+    set_headphone(parms->headphone);
+    
+    ensure_unified_filter();
+}
+
 void TCrescendo::render(Float32 *pinL, Float32 *pinR,
                         Float32 *poutL, Float32 *poutR,
                         UInt32 nel, bool replace,
                         tVTuningParams *parms)
+{
+    // either side alone, or both, R only when it is not L again
+    bool left  = (pinL && poutL);
+    bool right = (pinR && poutR && (pinL != pinR) && (poutL != poutR));
+    Float32 *pin[2]  = { left ? pinL : 0, right ? pinR : 0 };
+    Float32 *pout[2] = { left ? poutL : 0, right ? poutR : 0 };
+    
+    render_planar(pin, pout, (right ? 2 : 1), nel, replace, parms);
+}
+
+void TCrescendo::render_planar(Float32 **pin, Float32 **pout, UInt32 nchan,
+                               UInt32 nel, bool replace,
+                               tVTuningParams *parms)
 {
     DAZFZ env;
     
     if(parms)
+        apply_params(parms);
+    if(m_GainTables && m_TableBuilder)
+        update_gain_tables();
+    
+    nchan = min(nchan, m_nchans);
+    if(m_RateFactor > 1)
+        render_resampled(pin, pout, nchan, nel, replace);
+    else
+        render_core(pin, pout, nchan, nel, replace);
+}
+
+void TCrescendo::render_core(Float32 **pin, Float32 **pout, UInt32 nchan,
+                             UInt32 nel, bool replace)
+{
+    // With m_ParallelChannels the worker takes the upper half of the
+    // channels, or of the linked pairs, or of the lane blocks.
+    UInt32 half = (m_StereoLink ? 2*((nchan/2 + 1)/2) : (nchan + 1)/2);
+    if(lanes_active())
+        half = min(nchan, (half + VD_LANES - 1)/VD_LANES*VD_LANES);
+    
+    if(half < nchan && m_ParallelChannels && m_Worker)
+    {
+        m_WorkerJob.self    = this;
+        m_WorkerJob.pin     = pin;
+        m_WorkerJob.pout    = pout;
+        m_WorkerJob.first   = half;
+        m_WorkerJob.last    = nchan;
+        m_WorkerJob.nel     = nel;
+        m_WorkerJob.replace = replace;
+        m_Worker->post(render_job, &m_WorkerJob);
+        render_range(pin, pout, 0, half, nel, replace);
+        m_Worker->wait();
+    }
+    else
+        render_range(pin, pout, 0, nchan, nel, replace);
+}
+
+void TCrescendo::render_range(Float32 **pin, Float32 **pout,
+                              UInt32 first, UInt32 last,
+                              UInt32 nel, bool replace)
+{
+    // pairs in lockstep where a mode wants them, one at a time otherwise.
+    // Channels with null buffers sit this call out.
+    if(lanes_active())
+    {
+        render_range_lanes(pin, pout, first, last, nel, replace);
+        return;
+    }
+    bool pairs = (m_StereoLink || (m_StereoFFT && !m_ReuseDataFFT));
+    
+    for(UInt32 ix = first; ix < last; )
+    {
+        TCrescendo_bark_channel *chan = m_chans[ix]();
+        if(!(pin[ix] && pout[ix]))
+            ++ix;
+        else if(pairs && ix + 1 < last && pin[ix+1] && pout[ix+1] &&
+                chan->in_step_with(m_chans[ix+1]()))
+        {
+            chan->render_channel_pair(m_chans[ix+1](), pin[ix], pin[ix+1],
+                                      pout[ix], pout[ix+1], nel, replace);
+            ix += 2;
+        }
+        else
+        {
+            chan->render_channel(pin[ix], pout[ix], nel, replace);
+            ++ix;
+        }
+    }
+}
+
+void TCrescendo::render_range_lanes(Float32 **pin, Float32 **pout,
+                                    UInt32 first, UInt32 last,
+                                    UInt32 nel, bool replace)
+{
+    // render_range() a lane block at a time. Within a block, the first
+    // channel left takes along those in step with it and on its tuning,
+    // until none are left. A channel on its own runs as render_channel().
+    // first is on a block boundary, see render_core().
+    Float32 *gin[VD_LANES];
+    Float32 *gout[VD_LANES];
+    
+    for(UInt32 base = first; base < last; base += VD_LANES)
+    {
+        bark_lanes *lw  = &m_Lanes[base / VD_LANES];
+        UInt32      end = min(last, base + VD_LANES);
+        bool        done[VD_LANES];
+        
+        for(UInt32 ix = base; ix < base + VD_LANES; ++ix)
+            done[ix - base] = !(ix < end && pin[ix] && pout[ix]);
+        for(UInt32 ix = base; ix < end; ++ix)
+        {
+            if(done[ix - base])
+                continue;
+            TCrescendo_bark_channel *lead = m_chans[ix]();
+            UInt32 n = 0;
+            for(UInt32 c = 0; c < VD_LANES; ++c)
+            {
+                TCrescendo_bark_channel *chan = done[c] ? 0 : m_chans[base + c]();
+                if(chan && !(chan->in_step_with(lead) && chan->same_tuning(lead)))
+                    chan = 0;
+                lw->chan[c] = chan;
+                lw->live[c] = chan ? 1.0 : 0.0;
+                gin[c]  = chan ? pin[base + c] : 0;
+                gout[c] = chan ? pout[base + c] : 0;
+                if(chan)
+                {
+                    done[c] = true;
+                    ++n;
+                }
+            }
+            if(1 == n)
+                lead->render_channel(pin[ix], pout[ix], nel, replace);
+            else
+                TCrescendo_bark_channel::render_channel_lanes(lw, gin, gout, nel, replace);
+        }
+    }
+}
+
+void TCrescendo::render_resampled(Float32 **pin, Float32 **pout, UInt32 nchan,
+                                  UInt32 nel, bool replace)
+{
+    // Each channel decimates into its resampler, the core runs there at
+    // its own rate, and the result is interpolated back out to the host.
+    // Passes are at most RESAMPLE_CHUNK host samples. Channels with
+    // null buffers sit the call out, as in render_range().
+    Float32 *hin[CRESCENDO_MAX_CHANNELS];
+    Float32 *hout[CRESCENDO_MAX_CHANNELS];
+    Float32 *cin[CRESCENDO_MAX_CHANNELS];
+    Float32 *cout[CRESCENDO_MAX_CHANNELS];
+    UInt32   ncore[CRESCENDO_MAX_CHANNELS];
+    
+    if(0 == nchan)
+        return;
+    for(UInt32 ix = 0; ix < nchan; ++ix)
     {
-        set_CaldBFS(parms->CaldBFS);
-        set_CaldBSPL(parms->CaldBSPL);
-        set_vtuning(parms->vTune);
-        set_Processing(parms->proc_onoff);
-        // set_CorrectionsOnly(parms->corr_only_onoff);
-        set_VoldB(parms->voldB);
-        set_AttendB(parms->attendB);
-        // set_Brightness(parms->brighnessdB);
-        set_postEQ(parms->postEQ);
-        set_headphone(parms->headphone);
+        hin[ix]  = pin[ix];
+        hout[ix] = pout[ix];
+    }
+    while(nel > 0)
+    {
+        UInt32 n    = min(nel, UInt32(RESAMPLE_CHUNK));
+        UInt32 nc   = 0;
+        bool   same = true;
+        bool   any  = false;
+        for(UInt32 ix = 0; ix < nchan; ++ix)
+        {
+            ncore[ix] = 0;
+            cin[ix]   = 0;
+            cout[ix]  = 0;
+            if(!(hin[ix] && hout[ix]))
+                continue;
+            TResampler *rs = m_chans[ix]->get_Resampler();
+            ncore[ix] = rs->decimate(hin[ix], n);
+            cin[ix]   = rs->core_input();
+            cout[ix]  = rs->core_output();
+            same = same && (!any || ncore[ix] == nc);
+            nc   = ncore[ix];
+            any  = true;
+        }
         
-        ensure_unified_filter();
+        if(same)
+        {
+            if(nc > 0)
+                render_core(cin, cout, nchan, nc, true);
+        }
+        else
+        {
+            // channels a sample apart after mono calls, run them singly
+            for(UInt32 ix = 0; ix < nchan; ++ix)
+                if(ncore[ix] > 0)
+                    m_chans[ix]->render_channel(cin[ix], cout[ix], ncore[ix], true);
+        }
+        
+        for(UInt32 ix = 0; ix < nchan; ++ix)
+        {
+            if(!cin[ix])
+                continue;
+            m_chans[ix]->get_Resampler()->interpolate(hout[ix], n, replace);
+            hin[ix]  += n;
+            hout[ix] += n;
+        }
+        nel -= n;
     }
-	if(pinL && poutL)
-		m_lchan->render_channel(pinL, poutL, nel, replace);
-	if(pinR && poutR && (pinL != pinR) && (poutL != poutR))
-		m_rchan->render_channel(pinR, poutR, nel, replace);
 }
 
 void TCrescendo::get_levels(Float64 &lrms, Float64 &rrms)
 {
-	lrms = m_lchan->get_level();
-	rrms = m_rchan->get_level();
+	lrms = m_chans[0]->get_level();
+	rrms = m_chans[1]->get_level();
 }
 
+Float64 TCrescendo::get_level(UInt32 chan)
+{ return (chan < m_nchans ? m_chans[chan]->get_level() : 0.0); }
+
 Float64 TCrescendo::get_power()
-{ return m_lchan->get_level(); }
+{ return m_chans[0]->get_level(); }
+
+// in host samples, the core's own and the resampler's
+UInt32 TCrescendo::host_latency()
+{
+    UInt32 latency = m_RateFactor * (m_WOLA ? 4 : 5)*m_qblksize;
+    if(m_RateFactor > 1)
+        latency += m_chans[0]->get_Resampler()->get_latency();
+    return latency;
+}
 
 #ifdef MACOS
 Float64 TCrescendo::get_latency()
-{ return (((Float64)(5*m_qblksize))/m_sampleRate); }
+{ return (((Float64)host_latency())/m_hostRate); }
 #else
 UInt32 TCrescendo::get_latency()
-{ return (5*m_qblksize); }
+{ return host_latency(); }
 #endif
 
+TCrescendo_bark_channel* TCrescendo::get_channel(UInt32 ix)
+{ return m_chans[ix](); }
+
+// -------------------------------------------------------------------------------------
+
+TCrescendo_fanout::TCrescendo_fanout(Float64 sampleRate, UInt32 nprofiles)
+{
+    m_nprofiles = min(max(nprofiles, UInt32(1)), UInt32(CRESCENDO_MAX_PROFILES));
+    for(UInt32 ix = 0; ix < m_nprofiles; ++ix)
+        m_profiles[ix] = new TCrescendo(sampleRate);
+    m_Source = new TCrescendo_bark_channel(m_profiles[0]());
+    m_Source->SetSampleRate(sampleRate);
+    m_WOLA          = m_profiles[0]->get_WOLA();
+    m_FloatAnalysis = m_profiles[0]->get_FloatAnalysis();
+}
+
+TCrescendo_fanout::~TCrescendo_fanout()
+{}
+
+void TCrescendo_fanout::SetSampleRate(Float64 sampleRate)
+{
+    for(UInt32 ix = 0; ix < m_nprofiles; ++ix)
+        m_profiles[ix]->SetSampleRate(sampleRate);
+    m_Source->SetSampleRate(sampleRate);
+}
+
+void TCrescendo_fanout::set_DitherSeed(UInt32 seed)
+{
+    for(UInt32 ix = 0; ix < m_nprofiles; ++ix)
+        m_profiles[ix]->set_DitherSeed(seed);
+}
+
+void TCrescendo_fanout::apply_options(TCrescendo *prof)
+{
+    prof->set_WOLA(m_WOLA);
+    prof->set_FloatAnalysis(m_FloatAnalysis);
+}
+
+void TCrescendo_fanout::set_WOLA(bool arg)
+{
+    m_WOLA = arg;
+    for(UInt32 ix = 0; ix < m_nprofiles; ++ix)
+        apply_options(m_profiles[ix]());
+}
+
+void TCrescendo_fanout::set_FloatAnalysis(bool arg)
+{
+    m_FloatAnalysis = arg;
+    for(UInt32 ix = 0; ix < m_nprofiles; ++ix)
+        apply_options(m_profiles[ix]());
+}
+
+void TCrescendo_fanout::render(Float32 *pin, Float32 **pout, UInt32 nel, bool replace,
+                               tVTuningParams **parms)
+{
+    DAZFZ env;
+    TCrescendo *profiles[CRESCENDO_MAX_PROFILES];
+    
+    for(UInt32 ix = 0; ix < m_nprofiles; ++ix)
+    {
+        profiles[ix] = m_profiles[ix]();
+        if(parms && parms[ix])
+            profiles[ix]->apply_params(parms[ix]);
+        apply_options(profiles[ix]);
+        if(profiles[ix]->m_GainTables && profiles[ix]->m_TableBuilder)
+            profiles[ix]->update_gain_tables();
+    }
+    m_Source->render_channel_fanout(profiles, m_nprofiles, pin, pout, nel, replace);
+}
+
+#ifdef MACOS
+Float64 TCrescendo_fanout::get_latency()
+#else
+UInt32 TCrescendo_fanout::get_latency()
+#endif
+{ return m_profiles[0]->get_latency(); }
+
+Float64 TCrescendo_fanout::get_level(UInt32 ix)
+{ return (ix < m_nprofiles ? m_profiles[ix]->get_level(0) : 0.0); }
+
 // -- end of Crescendo.cpp -- //
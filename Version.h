@@ -38,6 +38,11 @@
 #ifndef __VERSION_H__
 #define __VERSION_H__
 
+#if defined(__APPLE__)
 #define MACOS	1
+#elif !defined(WIN32)
+// neither vDSP nor IPP -- use our own SIMD FFT kernels
+#define LINUX	1
+#endif
 
 #endif // __VERSION_H__
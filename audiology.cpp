@@ -78,9 +78,9 @@ void TCrescendo_bark_channel::set_vtuning(Float32 vtune)
 		UInt32   jx = (UInt32)floor(df);
 		df -= jx;
 
-		m_bark[ix].interp_frac = df;
-		m_bark[ix].pcoff1 = gfits[jx];
-		m_bark[ix].pcoff2 = gfits[jx+1];
+		m_bands.interp_frac[ix] = df;
+		m_bands.pcoff1[ix] = gfits[jx];
+		m_bands.pcoff2[ix] = gfits[jx+1];
     }
 }
 #else
@@ -107,11 +107,83 @@ void TCrescendo_bark_channel::set_vtuning(Float32 vtune)
 		UInt32   jx = (UInt32)floor(df);
 		df -= jx;
         
-		m_bark[ix].interp_frac = df;
-		m_bark[ix].pcoff1 = gfits[jx];
-		m_bark[ix].pcoff2 = gfits[jx+1];
+		m_bands.interp_frac[ix] = df;
+		m_bands.pcoff1[ix] = gfits[jx];
+		m_bands.pcoff2[ix] = gfits[jx+1];
+        for(int kx = 0; kx < 6; ++kx)
+        {
+            m_bands.coff1[kx][ix] = gfits[jx][kx];
+            m_bands.coff2[kx][ix] = gfits[jx+1][kx];
+        }
     }
+    
+    m_vTune = vtune;
+    
+    // published gain tables no longer apply
+    ++m_bandsSerial;
+    m_TableHops = 0;
 }
 #endif
 
+// -------------------------------------------------------------------------------------
+// Gain tables
+//
+// prepare_gain_tables() runs on the audio thread between renders. It picks
+// the unpublished buffer, which nobody reads, and records in it the band
+// coefficients to build from. build_gain_tables() then runs on the builder
+// thread. It recomputes only the bands whose coefficients changed since
+// the published tables, copies the rest, and publishes.
+//
+// The channels start using published tables GAIN_TABLE_HOPS hops after
+// the vtune change they are built for, not as soon as they appear, so the
+// output does not depend on the builder's timing or on the call sizes.
+// A build later than that, on a badly overloaded machine, only delays
+// the switch. The audio thread never waits for the builder.
+
+bool TCrescendo_bark_channel::gain_tables_stale()
+{
+    gain_tables *tbl = m_PublishedTables.load(std::memory_order_acquire);
+    return (0 == tbl || tbl->serial != m_bandsSerial);
+}
+
+void TCrescendo_bark_channel::prepare_gain_tables()
+{
+    gain_tables *tbl = m_PublishedTables.load(std::memory_order_acquire);
+    m_BuildTables = (tbl == &m_GainTables[0]) ? &m_GainTables[1] : &m_GainTables[0];
+    
+    m_BuildTables->serial = m_bandsSerial;
+    for(int ix = 0; ix < NBARKS; ++ix)
+    {
+        m_BuildTables->pcoff1[ix]      = m_bands.pcoff1[ix];
+        m_BuildTables->pcoff2[ix]      = m_bands.pcoff2[ix];
+        m_BuildTables->interp_frac[ix] = m_bands.interp_frac[ix];
+    }
+}
+
+void TCrescendo_bark_channel::build_gain_tables()
+{
+    gain_tables *prev = m_PublishedTables.load(std::memory_order_acquire);
+    gain_tables *tbl  = m_BuildTables;
+    
+    for(int ix = 0; ix < NBARKS; ++ix)
+    {
+        Float64  frac = tbl->interp_frac[ix];
+        Float64 *pc1  = tbl->pcoff1[ix];
+        Float64 *pc2  = tbl->pcoff2[ix];
+        
+        if(prev && prev->pcoff1[ix] == pc1 && prev->pcoff2[ix] == pc2 &&
+           prev->interp_frac[ix] == frac)
+        {
+            memcpy(tbl->gain[ix], prev->gain[ix], sizeof(tbl->gain[ix]));
+            continue;
+        }
+        for(int jx = 0; jx < GAIN_TABLE_SIZE; ++jx)
+        {
+            Float64 dbpwr = GAIN_TABLE_LO + jx * GAIN_TABLE_STEP;
+            tbl->gain[ix][jx] = (Float32)POST_SCALE(INTERPOLATE(dbpwr, frac, pc1, pc2));
+        }
+    }
+    m_PublishedTables.store(tbl, std::memory_order_release);
+}
+
 // -- end of audiology.cpp -- //
@@ -30,34 +30,25 @@
  ------------------------------------------------------------------------------- */
 
 #include <memory.h>
+#include <mutex>
 
 #include "Crescendo.h"
 
-// ---------------------------------------------------------
-// interpolation index and fraction for FFT cell values to Bark channel values
-UInt32  ixbk[128+1];
-Float64 fxbk[128+1];
-
-// interpolation index and fraction for Bark channel values to FFT cell values
-// for the first 129 FFT cells
-UInt32  ixft[NSUBBANDS*NFBANDS+3];
-Float64 fxft[NSUBBANDS*NFBANDS+3];
-
 // -----------------------------------------------------
 // Interpolation routines (Linear)
 
-inline Float64 ft_to_barkd(Float64 *ft_table, UInt32 bark_chan)
+inline Float64 ft_to_barkd(const TBarkTables *tbl, Float64 *ft_table, UInt32 bark_chan)
 {
-	UInt32  ix = ixft[bark_chan];
-	Float64 fx = fxft[bark_chan];
+	UInt32  ix = tbl->ixft[bark_chan];
+	Float64 fx = tbl->fxft[bark_chan];
     return ((1.0 - fx) * ft_table[ix] + fx * ft_table[ix+1]);
 }
 
 // -------------------------------------------------------------------------------------
-inline Float64 bark_to_ftf(Float64 *bark_table, UInt32 ft_chan)
+inline Float64 bark_to_ftf(const TBarkTables *tbl, Float64 *bark_table, UInt32 ft_chan)
 {
-	UInt32  ix = ixbk[ft_chan];
-	Float64 fx = fxbk[ft_chan];
+	UInt32  ix = tbl->ixbk[ft_chan];
+	Float64 fx = tbl->fxbk[ft_chan];
     return ((1.0 - fx) * bark_table[ix] + fx * bark_table[ix+1]);
 }
 
@@ -65,29 +56,108 @@ inline Float64 bark_to_ftf(Float64 *bark_table, UInt32 ft_chan)
 
 Float64 TCrescendo::compute_bark_powers(Float64 *pwr_spectrum, Float64 *bk_pwr)
 {
-    Float64 pwrsum, re, im;
+    Float64 pwrsum;
     Float64 ft_pwr[128+1]; // extra one for interpolation routines
-	UInt32  ix;
     // Full-scale sinewave should produce FFT amplitudes of 1/2 at +/- freq,
     // for a total power of 1/2 = -3 dB
     // But data windowing will affect the measured peak values.
     // DBM 11/16 - we are now self calibrating - no need for sf
     
-    // DC cell has half contribution
-    get_FT_DC(pwr_spectrum, re);
-    pwrsum = 0.5*re*re*m_UnifiedEQAmpl[0];
-    ft_pwr[0] = pwrsum;
+    // cumulative power, DC cell has half contribution
+    pwrsum = power_prefix_sum(pwr_spectrum, m_UnifiedEQAmpl, ft_pwr, 128);
+    
+    // just ignore Nyquist contribution
+    ft_pwr[128] = pwrsum;
+    
+    split_bark_powers(ft_pwr, bk_pwr);
+    return pwrsum;
+}
 
-    for(ix = 1; ix < 128; ++ix)
+Float64 TCrescendo::compute_bark_powers(Float32 *pwr_spectrum, Float64 *bk_pwr)
+{
+    // single precision spectrum, see FloatAnalysis, summed in double
+    Float64 pwrsum;
+    Float64 ft_pwr[128+1];
+    
+    pwrsum = power_prefix_sum(pwr_spectrum, m_UnifiedEQAmpl, ft_pwr, 128);
+    ft_pwr[128] = pwrsum;
+    
+    split_bark_powers(ft_pwr, bk_pwr);
+    return pwrsum;
+}
+
+void TCrescendo::compute_bark_powers_lanes(bark_lanes *lw)
+{
+    // compute_bark_powers() and update_level() for the channels in
+    // lw->chan side by side. The weighted cell powers are taken per
+    // channel, then the running sums and the split into bands go
+    // across the lanes, with the same interpolation indices in each.
+    const TBarkTables *tbl = m_BarkTables;
+    const UInt32 L = VD_LANES;
+    Float64 *ft_pwr = lw->ft_pwr;
+    Float64  pwr[VD_LANES][128];
+    Float64 *cols[VD_LANES];
+    Float64  total[VD_LANES];
+    Float64 *first = 0;
+    UInt32   c;
+    
+    for(c = 0; c < L; ++c)
     {
-        get_FT_cell(pwr_spectrum, ix, re, im);
-        pwrsum += (re*re + im*im)*m_UnifiedEQAmpl[ix];
-        ft_pwr[ix] = pwrsum;
+        TCrescendo_bark_channel *chan = lw->chan[c];
+        cols[c] = 0;
+        if(!chan)
+            continue;
+        if(m_FloatAnalysis)
+            chan->get_FFT()->power_spectrum(chan->get_PowerSpectrumF(), m_UnifiedEQAmpl, pwr[c], 128);
+        else
+            chan->get_FFT()->power_spectrum(chan->get_PowerSpectrum(), m_UnifiedEQAmpl, pwr[c], 128);
+        cols[c] = pwr[c];
+        if(!first)
+            first = pwr[c];
     }
+    // idle lanes take the first channel along
+    for(c = 0; c < L; ++c)
+        if(!cols[c])
+            cols[c] = first;
+    vd_interleave(cols, ft_pwr, 128);
     
-    // just ignore Nyquist contribution
-    ft_pwr[128] = pwrsum;
+    // cumulative power, DC cell has half contribution, Nyquist ignored
+    TVecD sum = vd_mul(vd_splat(0.5), vd_load(ft_pwr));
+    vd_store(ft_pwr, sum);
+    for(UInt32 ix = 1; ix < 128; ++ix)
+    {
+        sum = vd_add(sum, vd_load(ft_pwr + ix*L));
+        vd_store(ft_pwr + ix*L, sum);
+    }
+    vd_store(ft_pwr + 128*L, sum);
+    
+    vd_store(total, sum);
+    for(c = 0; c < L; ++c)
+        if(lw->chan[c])
+            lw->chan[c]->update_level(db10(total[c]) - get_selfCalSF());
+    
+    // see split_bark_powers()
+    TVecD ym1 = vd_splat(0.0);
+    TVecD y0  = ym1;
+    for(UInt32 ix = 0; ix < NSUBBANDS*NFBANDS; ++ix)
+    {
+        UInt32  jx  = tbl->ixft[ix+1];
+        Float64 fx  = tbl->fxft[ix+1];
+        TVecD   yp1 = vd_add(vd_mul(vd_splat(1.0 - fx), vd_load(ft_pwr + jx*L)),
+                             vd_mul(vd_splat(fx), vd_load(ft_pwr + (jx+1)*L)));
+        vd_store(lw->bk_pwr + ix*L, vd_sub(yp1, ym1));
+        ym1 = y0;
+        y0  = yp1;
+    }
+    
+    // each channel keeps its own copy, for measure_vector_gains()
+    for(c = 0; c < L; ++c)
+        cols[c] = lw->chan[c] ? lw->chan[c]->get_BarkSpectrum() : 0;
+    vd_deinterleave(lw->bk_pwr, cols, NSUBBANDS*NFBANDS);
+}
 
+void TCrescendo::split_bark_powers(Float64 *ft_pwr, Float64 *bk_pwr)
+{
     // At 48 kHz Fsamp, the highest 1/4-Bark bands used are #97 & #98
     //
     // A masking profile of -10 dB/Bark to the low side, and -20 dB/Bark
@@ -95,40 +165,41 @@ Float64 TCrescendo::compute_bark_powers(Float64 *pwr_spectrum, Float64 *bk_pwr)
     // 0.5 in power. Hence should be approx equiv to summing over 2
     // 1/4-Bark channels -- actually sounds pretty good!
     //
+    const TBarkTables *tbl = m_BarkTables;
     Float64 ym1 = 0.0;
     Float64 y0  = 0.0;
-    for(ix = 0; ix < NSUBBANDS*NFBANDS; ++ix)
+    for(UInt32 ix = 0; ix < NSUBBANDS*NFBANDS; ++ix)
     {
-        Float64 yp1 = ft_to_barkd(ft_pwr, ix+1);
+        Float64 yp1 = ft_to_barkd(tbl, ft_pwr, ix+1);
         bk_pwr[ix] = (yp1 - ym1);
         ym1 = y0;
         y0  = yp1;
     }
-    return pwrsum;
 }
 
 // -------------------------------------------------------------------------------------
 void TCrescendo::compute_ft_gains(Float64 *bark_gains, Float64 *ft_buf)
 {
-	Float64 ft_gain;
+    const TBarkTables *tbl = m_BarkTables;
+    Float64 gdb[128];
+    Float64 gain[128];
 	UInt32  ix;
     
-    ft_gain = ampl20(bark_gains[0] + m_UnifiedEQ[0]);
-    set_FT_DC(ft_buf, ft_gain);
-
+    gdb[0] = bark_gains[0] + m_UnifiedEQ[0];
     for(ix = 1; ix < 128; ++ix)
+        gdb[ix] = bark_to_ftf(tbl, bark_gains, ix) + m_UnifiedEQ[ix];
+    
+    if(get_FastDBMath())
+        vampl20(gdb, gain, 128);
+    else
     {
-        ft_gain = bark_to_ftf(bark_gains, ix) + m_UnifiedEQ[ix];
-        ft_gain = ampl20(ft_gain);
-        set_FT_cell(ft_buf, ix, ft_gain, 0.0);
+        for(ix = 0; ix < 128; ++ix)
+            gain[ix] = ampl20(gdb[ix]);
     }
     
-    // zap the frequency zone above audibility
-    for(ix = 128; ix < m_hblksize; ++ix)
-        set_FT_cell(ft_buf, ix, 0.0, 0.0);
-
-    // just zap the Nyquist contribution
-    set_FT_Nyquist(ft_buf, 0.0);
+    // real gains below 128, zap the frequency zone above audibility
+    // and the Nyquist contribution
+    set_real_gains(ft_buf, gain, 128);
 }
 
 // -------------------------------------------------------------------------------------
@@ -141,25 +212,19 @@ void TCrescendo::invalidate_unified_filter()
 
 void TCrescendo::ensure_unified_filter()
 {
-    static Float64 unifiedEQdB[128];
-    static Float64 unifiedEQAmpl[128];
-    
     if(0 == m_UnifiedEQ)
     {
-        Float64 *pATH  = m_InvATH;
-        Float64 *pPre  = m_PreEQAmpl;
-        Float64 *pHdph = m_HdphEQ;
+        for(int ix = 0; ix < kEQ_NParts; ++ix)
+            if(0 == m_EQParts[ix])
+                return; // not all parts in place yet
         
-        Float64 *pPreDB  = m_PreEQ;
-        Float64 *pPostDB = m_PostEQ;
+        // shared with every other instance using the same parts
+        const TUnifiedEQ *old = m_Unified;
+        m_Unified = TUnifiedEQ::acquire(m_EQParts);
+        TUnifiedEQ::release(old);
         
-        for(UInt32 ix = 0; ix < 128; ++ix)
-        {
-            unifiedEQAmpl[ix] = pATH[ix] * pPre[ix] * pHdph[ix];
-            unifiedEQdB[ix] = pPreDB[ix] - pPostDB[ix];
-        }
-        m_UnifiedEQAmpl = unifiedEQAmpl;
-        m_UnifiedEQ = unifiedEQdB;
+        m_UnifiedEQAmpl = m_Unified->ampl;
+        m_UnifiedEQ = m_Unified->dB;
     }
 }
 
@@ -176,7 +241,20 @@ Float64 inv_cbr(Float64 zbark)
 }
 
 // -------------------------------------------------------------------------------------
-void TCrescendo::fill_bark_tables()
+TBarkTables::TBarkTables(Float64 sampleRate, UInt32 blksize)
+{
+    m_sampleRate = sampleRate;
+    m_blksize    = blksize;
+    m_nsubbands  = NSUBBANDS;
+    m_refs       = 0;
+    m_next       = 0;
+    
+    fill_bark_tables();
+    fill_ft_tables();
+}
+
+// -------------------------------------------------------------------------------------
+void TBarkTables::fill_bark_tables()
 {
     ixft[0] = 0;
     fxft[0] = 0.0;
@@ -197,7 +275,7 @@ void TCrescendo::fill_bark_tables()
 }
 
 // -------------------------------------------------------------------------------------
-void TCrescendo::fill_ft_tables()
+void TBarkTables::fill_ft_tables()
 {
 	ixbk[0] = 0;
 	fxbk[0] = 0.0;
@@ -212,10 +290,63 @@ void TCrescendo::fill_ft_tables()
     }
 }
 
+// -------------------------------------------------------------------------------------
+// Process-wide cache of table sets. The lock is held only while
+// a processor changes sample rate or goes away, never while rendering.
+
+static std::mutex   gBarkTablesLock;
+static TBarkTables *gBarkTables = 0;
+
+const TBarkTables *TBarkTables::acquire(Float64 sampleRate, UInt32 blksize)
+{
+    std::lock_guard<std::mutex> lock(gBarkTablesLock);
+    
+    TBarkTables *tbl;
+    for(tbl = gBarkTables; tbl; tbl = tbl->m_next)
+    {
+        if(tbl->m_sampleRate == sampleRate &&
+           tbl->m_blksize == blksize &&
+           tbl->m_nsubbands == NSUBBANDS)
+            break;
+    }
+    if(0 == tbl)
+    {
+        tbl = new TBarkTables(sampleRate, blksize);
+        tbl->m_next = gBarkTables;
+        gBarkTables = tbl;
+    }
+    ++tbl->m_refs;
+    return tbl;
+}
+
+void TBarkTables::release(const TBarkTables *tables)
+{
+    if(0 == tables)
+        return;
+    
+    std::lock_guard<std::mutex> lock(gBarkTablesLock);
+    
+    TBarkTables **pp;
+    for(pp = &gBarkTables; *pp; pp = &(*pp)->m_next)
+    {
+        TBarkTables *tbl = *pp;
+        if(tbl == tables)
+        {
+            if(0 == --tbl->m_refs)
+            {
+                *pp = tbl->m_next;
+                delete tbl;
+            }
+            return;
+        }
+    }
+}
+
 // -------------------------------------------------------------------------------------
 void TCrescendo::fill_bark_interpolation_tables()
 {
-  fill_bark_tables();
-  fill_ft_tables();
+    const TBarkTables *old = m_BarkTables;
+    m_BarkTables = TBarkTables::acquire(m_sampleRate, m_blksize);
+    TBarkTables::release(old);
 }
 
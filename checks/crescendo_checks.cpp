@@ -0,0 +1,448 @@
+// crescendo_checks.cpp -- regression checks for the engine's optional paths
+// DM/RAL  10/26
+// -------------------------------------------------------------
+
+/* -----------------------------------------------------------------------------
+ Copyright (c) 2016 Refined Audiometrics Laboratory, LLC
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ 3. The names of the authors and contributors may not be used to endorse
+ or promote products derived from this software without specific prior
+ written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+ ------------------------------------------------------------------------------- */
+
+// Each check runs an optional path against the reference it replaces
+// and fails when the difference exceeds the bound its commit claims.
+// Build with the library sources, the same way the host project does,
+// and run; the exit status is the number of failed checks.
+//
+//   c++ -std=c++11 -O2 -pthread -I.. ../*.cpp crescendo_checks.cpp
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <thread>
+
+#include "crescendo_dspPriv.h"
+
+static int gFailures = 0;
+
+static void report(const char *name, Float64 value, Float64 bound)
+{
+    bool ok = (value <= bound);
+    printf("%-40s %12.4g  (bound %.4g)  %s\n", name, value, bound, ok ? "ok" : "FAILED");
+    if(!ok)
+        ++gFailures;
+}
+
+// tone bursts over a noise floor, reproducible
+static void make_signal(std::vector<Float32> &sig, Float64 sampleRate, Float64 secs)
+{
+    UInt32 nel  = (UInt32)(secs * sampleRate);
+    UInt32 seed = 1;
+    Float64 pi  = acos(-1.0);
+    
+    sig.resize(nel);
+    for(UInt32 ix = 0; ix < nel; ++ix)
+    {
+        seed = seed*1664525u + 1013904223u;
+        Float64 noise = (seed >> 8) * (1.0/16777216.0) - 0.5;
+        Float64 env   = ((UInt32)(ix / (0.25*sampleRate)) % 2) ? 0.3 : 0.01;
+        sig[ix] = (Float32)(env * sin(2.0*pi*440.0*ix/sampleRate) + 0.05*noise);
+    }
+}
+
+static void default_params(tVTuningParams &parms)
+{
+    memset(&parms, 0, sizeof(parms));
+    parms.proc_onoff = 1;
+    parms.vTune      = 40;
+    parms.attendB    = -10;
+    parms.CaldBSPL   = 77;
+    parms.CaldBFS    = -17;
+    parms.postEQ     = 1;
+    parms.headphone  = 3;
+}
+
+// ---------------------------------------------------------------
+// SpectralFilter: the smoothed filter stays within the deviation
+// init_filter_kernel() claims for it, and that within tolerance
+
+static void check_filter_deviation()
+{
+    static const Float64 rates[] = { 44100.0, 48000.0, 96000.0 };
+    tVTuningParams parms;
+    default_params(parms);
+    
+    for(UInt32 ir = 0; ir < 3; ++ir)
+    {
+        std::vector<Float32> sig, out;
+        make_signal(sig, rates[ir], 2.0);
+        out.resize(sig.size());
+        
+        TCrescendo cresc(rates[ir]);
+        cresc.set_SpectralFilter(true);
+        
+        Float64 worst = 0.0;
+        UInt32  blk   = 512;
+        for(UInt32 ix = 0; ix + blk <= sig.size(); ix += blk)
+        {
+            cresc.render(&sig[ix], 0, &out[ix], 0, blk, true, &parms);
+            worst = max(worst, cresc.measure_filter_deviation());
+        }
+        
+        char name[64];
+        snprintf(name, sizeof(name), "filter deviation, claimed, %g Hz", rates[ir]);
+        report(name, cresc.get_FilterDeviation(), SPECTRAL_FILTER_TOL);
+        snprintf(name, sizeof(name), "filter deviation, measured, %g Hz", rates[ir]);
+        report(name, worst, cresc.get_FilterDeviation());
+    }
+}
+
+// ---------------------------------------------------------------
+// VectorBarkGains: from the same band state, the vector gains agree
+// with the scalar ones to within the 0.01 dB budget
+
+static void check_vector_gains()
+{
+    static const Float64 rates[] = { 44100.0, 48000.0, 96000.0 };
+    tVTuningParams parms;
+    default_params(parms);
+    
+    for(UInt32 ir = 0; ir < 3; ++ir)
+    {
+        std::vector<Float32> sig, outL, outR;
+        make_signal(sig, rates[ir], 2.0);
+        outL.resize(sig.size());
+        outR.resize(sig.size());
+        
+        TCrescendo cresc(rates[ir]);
+        cresc.set_VectorBarkGains(true);
+        
+        Float64 worst = 0.0;
+        UInt32  blk   = 512;
+        for(UInt32 ix = 0; ix + blk <= sig.size(); ix += blk)
+        {
+            cresc.render(&sig[ix], &sig[ix], &outL[ix], &outR[ix], blk, true, &parms);
+            worst = max(worst, cresc.measure_vector_gains());
+        }
+        
+        char name[64];
+        snprintf(name, sizeof(name), "vector Bark gains, dB, %g Hz", rates[ir]);
+        report(name, worst, 0.01);
+    }
+}
+
+// ---------------------------------------------------------------
+// FastDBMath: vdb10() and vampl20() against libm, over the range the
+// Bark and FT gain stages see, within the 0.001 dB budget
+
+static void check_fast_db_math()
+{
+    const UInt32 nel  = 100000;
+    UInt32       seed = 7;
+    std::vector<Float64> src(nel), fast(nel);
+    
+    // powers from 1e-16 to 1e4, with scattered mantissas
+    for(UInt32 ix = 0; ix < nel; ++ix)
+    {
+        seed = seed*1664525u + 1013904223u;
+        src[ix] = pow(10.0, -16.0 + 20.0*ix/nel) * (1.0 + (seed >> 8) * (1.0/16777216.0));
+    }
+    vdb10(&src[0], &fast[0], nel);
+    Float64 worst = 0.0;
+    for(UInt32 ix = 0; ix < nel; ++ix)
+        worst = max(worst, fabs(fast[ix] - db10(src[ix])));
+    report("vdb10 vs db10, dB", worst, 0.001);
+    
+    // gains from -140 to +60 dB
+    for(UInt32 ix = 0; ix < nel; ++ix)
+    {
+        seed = seed*1664525u + 1013904223u;
+        src[ix] = -140.0 + 200.0*ix/nel + (seed >> 8) * (1.0/16777216.0);
+    }
+    vampl20(&src[0], &fast[0], nel);
+    worst = 0.0;
+    for(UInt32 ix = 0; ix < nel; ++ix)
+        worst = max(worst, fabs(20.0*log10(fast[ix] / ampl20(src[ix]))));
+    report("vampl20 vs ampl20, dB", worst, 0.001);
+}
+
+// ---------------------------------------------------------------
+// FloatAnalysis: band powers within 120 dB of the total agree with
+// the double analysis to 0.002 dB, on every hop of the test signal
+
+static void check_float_analysis()
+{
+    static const Float64 rates[] = { 44100.0, 48000.0, 96000.0 };
+    tVTuningParams parms;
+    default_params(parms);
+    
+    for(UInt32 ir = 0; ir < 3; ++ir)
+    {
+        std::vector<Float32> sig, out;
+        make_signal(sig, rates[ir], 2.0);
+        out.resize(sig.size());
+        
+        TCrescendo cresc(rates[ir]);
+        UInt32 blksize  = cresc.get_blksize();
+        UInt32 hblksize = cresc.get_hblksize();
+        // once, for the parameters and the headphone EQ
+        cresc.render(&sig[0], 0, &out[0], 0, hblksize, true, &parms);
+        
+        std::vector<Float64> seg(blksize);
+        Float64 worst = 0.0;
+        for(UInt32 ix = 0; ix + blksize <= sig.size(); ix += hblksize)
+        {
+            for(UInt32 jx = 0; jx < blksize; ++jx)
+                seg[jx] = sig[ix + jx];
+            worst = max(worst, cresc.measure_float_analysis(&seg[0]));
+        }
+        
+        char name[64];
+        snprintf(name, sizeof(name), "float analysis band powers, dB, %g Hz", rates[ir]);
+        report(name, worst, 0.002);
+    }
+}
+
+// ---------------------------------------------------------------
+// ResampleHighRates: an impulse comes out get_latency() samples
+// later, 768 at 96 kHz with the core at 48 kHz
+
+static void check_latency()
+{
+    static const Float64 rates[]    = { 48000.0, 96000.0, 96000.0 };
+    static const bool    resample[] = { false,   false,   true    };
+    tVTuningParams parms;
+    default_params(parms);
+    
+    for(UInt32 ir = 0; ir < 3; ++ir)
+    {
+        UInt32 nel = (UInt32)rates[ir];
+        UInt32 at  = nel/2;
+        std::vector<Float32> sig(nel, 0.0f), out(nel);
+        sig[at] = 0.5f;
+        
+        TCrescendo cresc(rates[ir]);
+        cresc.set_ResampleHighRates(resample[ir]);
+        for(UInt32 ix = 0; ix < nel; ix += 100)
+            cresc.render(&sig[ix], 0, &out[ix], 0, min(UInt32(100), nel - ix), true, &parms);
+        
+        UInt32 peak = 0;
+        for(UInt32 ix = 0; ix < nel; ++ix)
+        {
+            if(fabs(out[ix]) > fabs(out[peak]))
+                peak = ix;
+        }
+#ifdef MACOS
+        Float64 latency = floor(cresc.get_latency() * rates[ir] + 0.5);
+#else
+        Float64 latency = cresc.get_latency();
+#endif
+        
+        char name[64];
+        snprintf(name, sizeof(name), "impulse delay vs latency, %g Hz%s",
+                 rates[ir], resample[ir] ? " rs" : "");
+        report(name, fabs((Float64)peak - at - latency), 0.0);
+        if(resample[ir])
+            report("latency - 768, 96000 Hz rs", fabs(latency - 768.0), 0.0);
+    }
+}
+
+// ---------------------------------------------------------------
+// TStreamHost: more streams than threads, pushed and pulled unevenly,
+// across a stop() and start(). Each stream's output, hop by hop, is
+// what its own processor gives rendering the stream directly.
+
+static void check_stream_host()
+{
+    const Float64 sampleRate = 48000.0;
+    const UInt32  nstreams   = 5;
+    const UInt32  nthreads   = 2;
+    std::vector<Float32> sig;
+    make_signal(sig, sampleRate, 1.0);
+    
+    TStreamHost host(nstreams, sampleRate, nthreads);
+    tVTuningParams parms[nstreams];
+    for(UInt32 ix = 0; ix < nstreams; ++ix)
+    {
+        default_params(parms[ix]);
+        parms[ix].vTune = 10 + 7*ix;
+        host.set_params(ix, &parms[ix]);
+        // the default dither is unseeded, it would not repeat
+        host.get_processor(ix)->set_DitherSeed(ix + 1);
+    }
+    
+    // odd streams stereo, the right channel the signal reversed
+    std::vector<Float32> rev(sig.rbegin(), sig.rend());
+    std::vector<Float32> outL[nstreams], outR[nstreams];
+    UInt32 pushed[nstreams], pulled[nstreams];
+    UInt32 hop = 0, nhops = 0;
+    
+    for(UInt32 run = 0; run < 2; ++run)
+    {
+        host.start();
+        hop = host.get_hop(0);
+        nhops = (UInt32)(sig.size() / hop);
+        UInt32 first = run*nhops/2;
+        UInt32 last  = (run + 1)*nhops/2;
+        for(UInt32 ix = 0; ix < nstreams; ++ix)
+        {
+            pushed[ix] = pulled[ix] = first;
+            outL[ix].resize(nhops*hop);
+            outR[ix].resize(nhops*hop);
+        }
+        
+        bool busy = true;
+        for(UInt32 turn = 0; busy; ++turn)
+        {
+            busy = false;
+            for(UInt32 ix = 0; ix < nstreams; ++ix)
+            {
+                bool stereo = (ix & 1);
+                for(UInt32 n = (turn + ix) % 4; n && pushed[ix] < last; --n)
+                {
+                    UInt32 at = pushed[ix]*hop;
+                    if(!host.push(ix, &sig[at], stereo ? &rev[at] : 0))
+                        break;
+                    ++pushed[ix];
+                }
+                while(pulled[ix] < pushed[ix])
+                {
+                    UInt32 at = pulled[ix]*hop;
+                    if(!host.pull(ix, &outL[ix][at], stereo ? &outR[ix][at] : 0))
+                        break;
+                    ++pulled[ix];
+                }
+                busy = busy || (pulled[ix] < last);
+            }
+            std::this_thread::yield();
+        }
+        host.stop();
+    }
+    
+    Float64 worst = 0.0;
+    for(UInt32 ix = 0; ix < nstreams; ++ix)
+    {
+        bool stereo = (ix & 1);
+        std::vector<Float32> refL(nhops*hop), refR(nhops*hop);
+        TCrescendo cresc(sampleRate);
+        cresc.set_DitherSeed(ix + 1);
+        for(UInt32 jx = 0; jx < nhops; ++jx)
+            cresc.render(&sig[jx*hop], stereo ? &rev[jx*hop] : 0,
+                         &refL[jx*hop], stereo ? &refR[jx*hop] : 0,
+                         hop, true, &parms[ix]);
+        for(UInt32 jx = 0; jx < nhops*hop; ++jx)
+        {
+            worst = max(worst, (Float64)fabs(outL[ix][jx] - refL[jx]));
+            if(stereo)
+                worst = max(worst, (Float64)fabs(outR[ix][jx] - refR[jx]));
+        }
+    }
+    report("stream host vs direct, 5 streams 2 threads", worst, 0.0);
+}
+
+// ---------------------------------------------------------------
+// ChannelLanes: six channels, a full lane block and a partial one,
+// against VectorBarkGains alone. The lanes do the same arithmetic, so
+// the outputs match exactly when the compiler keeps the scalar
+// interpolations unfused, as in the build line above. With -mfma the
+// reference's band edges are fused and its output moves by about
+// 0.002 of full scale, hence the bound.
+
+static void check_channel_lanes()
+{
+    const Float64 sampleRate = 48000.0;
+    const UInt32  nchan      = 6;
+    static const UInt32 chunks[] = { 300, 517, 64, 1031 };
+    tVTuningParams parms;
+    default_params(parms);
+    std::vector<Float32> sig;
+    make_signal(sig, sampleRate, 2.0);
+    
+    for(UInt32 spec = 0; spec < 2; ++spec)
+    {
+        TCrescendo vect(sampleRate), lanes(sampleRate);
+        TCrescendo *cresc[2] = { &vect, &lanes };
+        std::vector<Float32> in[nchan], out[2][nchan];
+        float *pin[nchan], *pout[2][nchan];
+        UInt32 nel = (UInt32)sig.size() - 4096;
+        for(UInt32 ic = 0; ic < nchan; ++ic)
+        {
+            // the same program, offset and scaled per channel
+            in[ic].resize(nel);
+            for(UInt32 jx = 0; jx < nel; ++jx)
+                in[ic][jx] = sig[jx + 613*ic] * (1.0f - 0.1f*ic);
+            out[0][ic].resize(nel);
+            out[1][ic].resize(nel);
+        }
+        for(UInt32 iv = 0; iv < 2; ++iv)
+        {
+            cresc[iv]->set_NumChannels(nchan);
+            cresc[iv]->set_DitherSeed(3);
+            cresc[iv]->set_VectorBarkGains(true);
+            cresc[iv]->set_SpectralFilter(spec != 0);
+            cresc[iv]->set_ChannelLanes(iv != 0);
+        }
+        
+        UInt32 at = 0;
+        for(UInt32 ix = 0; at < nel; ++ix)
+        {
+            UInt32 blk = min(chunks[ix % 4], nel - at);
+            for(UInt32 iv = 0; iv < 2; ++iv)
+            {
+                for(UInt32 ic = 0; ic < nchan; ++ic)
+                {
+                    pin[ic] = &in[ic][at];
+                    pout[iv][ic] = &out[iv][ic][at];
+                }
+                cresc[iv]->render_planar(pin, pout[iv], nchan, blk, true, &parms);
+            }
+            at += blk;
+        }
+        
+        Float64 worst = 0.0;
+        for(UInt32 ic = 0; ic < nchan; ++ic)
+            for(UInt32 jx = 0; jx < nel; ++jx)
+                worst = max(worst, (Float64)fabs(out[0][ic][jx] - out[1][ic][jx]));
+        report(spec ? "channel lanes vs vector, SpectralFilter"
+                    : "channel lanes vs vector gains", worst, 0.02);
+    }
+}
+
+// ---------------------------------------------------------------
+
+int main()
+{
+    check_filter_deviation();
+    check_vector_gains();
+    check_fast_db_math();
+    check_float_analysis();
+    check_latency();
+    check_stream_host();
+    check_channel_lanes();
+    return gFailures;
+}
+
+// -- end of crescendo_checks.cpp -- //
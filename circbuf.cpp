@@ -90,4 +90,15 @@ void TCircbuf::get(Float64 *pdata, UInt32 nel, bool replace)
 		incrmod(m_get, n, m_nel);
 }
 
+//-------------------------------------------------------------------
+//
+UInt32 TCircbuf::get_span(Float64 *&pdata, UInt32 nel)
+{
+	UInt32 n = min(nel, m_nel - m_get);
+	
+	pdata = m_pdata() + m_get;
+	incrmod(m_get, n, m_nel);
+	return n;
+}
+
 // -- end of circbuf.cpp -- //
@@ -49,6 +49,10 @@ public:
 
   void put(Float64 *pdata, UInt32 nel);
   void get(Float64 *pdata, UInt32 nel, bool replace = true);
+
+  // read in place: points pdata at the next of up to nel samples,
+  // consumes and returns as many as lie contiguous there
+  UInt32 get_span(Float64 *&pdata, UInt32 nel);
 };
     
 #endif // __CIRCBUF_H__
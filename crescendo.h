@@ -43,6 +43,9 @@
 #include "TFilter.h"
 #include "hdpheq.h"
 #include "vTuningParams.h"
+#include "old-dither.h"
+#include "resample.h"
+#include <atomic>
 
 // -------------------------------------------------------------
 // The Crescendo 3D Algorithm
@@ -51,21 +54,182 @@
 #define NFBANDS         25
 #define NSUBBANDS		4
 
+// how a linked stereo analysis combines the two channels' band powers,
+// see TCrescendo::set_StereoLink(). The mean is half the power sum, so
+// that a centred mono source is analysed just as either channel alone.
+enum { kStereoLinkOff, kStereoLinkMax, kStereoLinkMean };
+
+// channels one processor can carry, enough for a 7.1 bed
+#define CRESCENDO_MAX_CHANNELS  8
+
+// host samples per pass through the core when resampling
+#define RESAMPLE_CHUNK  1024
+
+// max relative deviation from the reference filter allowed
+// when truncating the spectral smoothing kernel
+#define SPECTRAL_FILTER_TOL  0.01
+
 // -------------------------------------------------------------
 //
-struct bark_rec {
+// State of the 1/4-Bark bands, as a structure of arrays so that
+// compute_bark_gains() can run across bands in vector lanes.
+
+#define NBARKS   (NSUBBANDS*NFBANDS+1)
+
+// Each band's dBHL -> gain curve, POST_SCALE(INTERPOLATE(...)), tabulated
+// over the domain of the rational fits. Linear interpolation between
+// 0.5 dB points stays within 0.002 dB of the fits. The MaxGain clamp
+// is applied after the lookup, a clamp inside the table would put a
+// kink between table points.
+#define GAIN_TABLE_LO     20.0   // 100 dB + dbmin of the fits
+#define GAIN_TABLE_STEP    0.5
+#define GAIN_TABLE_SIZE  161     // up to 100 dB
+
+// The tables take over this many hops after a vtune change, so the
+// switch does not move with the builder's timing, unless the build is
+// later still. Until then the rational fits serve, see compute_bark_gains()
+#define GAIN_TABLE_HOPS   32
+
+struct gain_tables {
+    // what the tables were built from, see prepare_gain_tables()
+    UInt32   serial;
+    Float64 *pcoff1[NBARKS];
+    Float64 *pcoff2[NBARKS];
+    Float64  interp_frac[NBARKS];
+    
+    Float32  gain[NBARKS][GAIN_TABLE_SIZE];
+};
+
+struct bark_bands {
     // the following are dynamically updated during processing
-    Float64  prev_pwr;
-    Float64  mean_pwr;
-    Float64  release;
-    SInt32   holdctr;
+    Float64  prev_pwr[NBARKS];
+    Float64  mean_pwr[NBARKS];
+    Float64  release[NBARKS];
+    Float64  holdctr[NBARKS];   // whole numbers, Float64 for the vector lanes
     
-    Float64  prev_gain;
+    Float64  prev_gain[NBARKS];
     
     // the following set by set_vtuning for each Bark band
-    Float64  interp_frac;
-    Float64 *pcoff1;
-    Float64 *pcoff2;
+    Float64  interp_frac[NBARKS];
+    Float64 *pcoff1[NBARKS];
+    Float64 *pcoff2[NBARKS];
+    Float64  coff1[6][NBARKS];  // *pcoff1 and *pcoff2, gathered
+    Float64  coff2[6][NBARKS];
+    
+    // set once from gFletch, see dbfs_to_dbhl() and gdbhl_to_gdbspl()
+    Float64  hl_div[NBARKS];
+    Float64  spl_mul[NBARKS];
+};
+
+// -------------------------------------------------------------
+// A block of VD_LANES channels side by side, channel ix in lane
+// ix % VD_LANES, see TCrescendo::render_samples_lanes(). Row ix of
+// lane c is at [ix*VD_LANES + c]. The band state stays here between
+// hops, see TCrescendo_bark_channel::enter_lanes(). Lanes without a
+// channel this hop are computed along and not stored.
+
+class TCrescendo_bark_channel;
+
+struct bark_lanes {
+    TCrescendo_bark_channel *chan[VD_LANES];   // this hop's, 0 when idle
+    Float64  live[VD_LANES];                   // 1 where chan is set
+    
+    // band state, see bark_bands
+    Float64  mean_pwr[NBARKS*VD_LANES];
+    Float64  prev_pwr[NBARKS*VD_LANES];
+    Float64  release[NBARKS*VD_LANES];
+    Float64  holdctr[NBARKS*VD_LANES];
+    Float64  prev_gain[NBARKS*VD_LANES];
+    
+    // this hop's
+    Float64  ft_pwr[(128+1)*VD_LANES];      // cumulative cell powers
+    Float64  bk_pwr[NBARKS*VD_LANES];       // band powers, then levels in dB
+    Float64  dither[3][NBARKS*VD_LANES];    // mean, prev and gain relaxations
+    Float64  crest[VD_LANES];
+    Float64  gain[NBARKS*VD_LANES];         // Bark gains, dB
+    Float64  cell_gain[128*VD_LANES];       // dB, then amplitude
+    Float64  gpad[(128 + 3*64)*VD_LANES];   // for SpectralFilter
+    Float64  filter[(128 + 64)*VD_LANES];
+};
+
+// -------------------------------------------------------------
+// Interpolation tables between FFT cells and 1/4-Bark bands.
+// They depend only on sample rate and block size, so they are built
+// once per (sampleRate, blksize, NSUBBANDS) and shared, read-only, by
+// every processor running with those settings. See bark_fft2.cpp.
+
+class TBarkTables
+{
+    Float64      m_sampleRate;
+    UInt32       m_blksize;
+    UInt32       m_nsubbands;
+    UInt32       m_refs;
+    TBarkTables *m_next;
+    
+    TBarkTables(Float64 sampleRate, UInt32 blksize);
+    
+    void fill_bark_tables();
+    void fill_ft_tables();
+    
+public:
+    // interpolation index and fraction, FFT cell to Bark band
+    UInt32  ixbk[128+1];
+    Float64 fxbk[128+1];
+    
+    // interpolation index and fraction, Bark band to FFT cell,
+    // for the first 129 FFT cells
+    UInt32  ixft[NSUBBANDS*NFBANDS+3];
+    Float64 fxft[NSUBBANDS*NFBANDS+3];
+    
+    // find or build the tables, and take a reference to them.
+    // Not for the audio thread.
+    static const TBarkTables *acquire(Float64 sampleRate, UInt32 blksize);
+    
+    // drop a reference, the last one out frees the tables
+    static void release(const TBarkTables *tables);
+};
+
+// -------------------------------------------------------------
+// Scratch state for one pass through the engine. Each channel owns
+// one, so that the channels may render concurrently. The processor
+// keeps one more for calibration.
+
+class TCrescendo_workspace
+{
+protected:
+    TPtr<ipp_fft> m_FFT;
+    
+    DZPtr    m_PowerSpectrum;
+    TPtr<Float32> m_PowerSpectrumF;   // for FloatAnalysis
+    DZPtr    m_Filter;
+    DZPtr    m_Data;
+    
+    Float64  m_BarkSpectrum[128];
+    Float64  m_BarkGains[128];
+    
+public:
+    void alloc_workspace(UInt32 fft_order);
+    
+    ipp_fft* get_FFT()
+    { return m_FFT(); }
+    
+    Float64* get_PowerSpectrum()
+	{ return m_PowerSpectrum(); }
+    
+    Float32* get_PowerSpectrumF()
+	{ return m_PowerSpectrumF(); }
+    
+    Float64* get_Filter()
+	{ return m_Filter(); }
+    
+	Float64* get_Data()
+	{ return m_Data(); }
+    
+	Float64* get_BarkSpectrum()
+	{ return m_BarkSpectrum; }
+    
+	Float64* get_BarkGains()
+	{ return m_BarkGains; }
 };
 
 // -------------------------------------------------------------
@@ -78,39 +242,110 @@ void set_##name(type arg) { m_##name = arg; }
 // -------------------------------------------------------------
 //
 class TCrescendo_bark_channel;
+class TWorker;
+class TCrescendo;
+class TCrescendo_fanout;
+
+// the worker's share of a parallel rendering, channels first to last-1
+struct tChannelJob {
+    TCrescendo *self;
+    Float32   **pin;
+    Float32   **pout;
+    UInt32      first;
+    UInt32      last;
+    UInt32      nel;
+    bool        replace;
+};
 
 class TCrescendo
 {
-	TPtr<TCrescendo_bark_channel> m_lchan;
-	TPtr<TCrescendo_bark_channel> m_rchan;
+    friend class TCrescendo_fanout;
+    
+    // channel 0 is left and 1 is right, the rest are for planar beds.
+    // Everything else in here is shared by all of them.
+	TPtr<TCrescendo_bark_channel> m_chans[CRESCENDO_MAX_CHANNELS];
+    UInt32  m_nchans;    // at least 2
+    
+    bool    m_DitherSeeded;
+    UInt32  m_DitherSeed;
     
     DZPtr m_DataWindow;
     DZPtr m_HalfWindow;
-    TPtr<ipp_fft> m_AudioFFT;
+    DZPtr m_SineWindow;
+    
+    // calibration scratch, and the FFT cell layout for everyone
+    TCrescendo_workspace m_Work;
+    ipp_fft *m_AudioFFT;
+    
+    bool         m_PlainRelax;
+    
+    // builds the channels' gain tables when m_GainTables
+    bool         m_GainTables;
+    TWorker     *m_TableBuilder;
+    TCrescendo_bark_channel *m_TableJob[CRESCENDO_MAX_CHANNELS+1];  // 0 ends
+    void update_gain_tables();
+    
+    // lane blocks for m_ChannelLanes, channel ix in block ix / VD_LANES
+    bool         m_ChannelLanes;
+    bark_lanes  *m_Lanes;
+    bool lanes_active()
+    { return (m_ChannelLanes && !m_WOLA && !m_ReuseDataFFT && !m_StereoLink && !m_StereoFFT); }
+    void render_range_lanes(float **pin, float **pout,
+                            UInt32 first, UInt32 last,
+                            UInt32 nel, bool replace);
+    
+    // renders the right channel when m_ParallelChannels
+    bool         m_ParallelChannels;
+    TWorker     *m_Worker;
+    tChannelJob  m_WorkerJob;
     
     t_EQStruct *m_HdphEQ_basis;
     t_EQStruct *m_PostEQ_basis;
-    Float64     m_InvATH[129];
     
-    // coalesced EQ's
-    Float64*    m_UnifiedEQ;
-    Float64*    m_UnifiedEQAmpl;
+    // interned EQ curves, indexed by kEQ_InvATH etc.
+    const TEQCurve   *m_EQParts[kEQ_NParts];
+    const TUnifiedEQ *m_Unified;
     
-    DZPtr  m_PowerSpectrum;
-    DZPtr  m_Filter;
-    DZPtr  m_Data;
+    // shared, read-only Bark interpolation tables for our rate
+    const TBarkTables *m_BarkTables;
     
-    Float64 m_BarkSpectrum[128];
-    Float64 m_BarkGains[128];
+    // coalesced EQ's
+    const Float64 *m_UnifiedEQ;
+    const Float64 *m_UnifiedEQAmpl;
     
-    float   m_sampleRate;
+    // sparse frequency domain equivalent of the filter truncation window
+    UInt32   m_KernelTaps;
+    UInt32   m_KernelSpan;
+    SInt32   m_KernelOffset[64];
+    Float64  m_KernelWeight[64];
+    Float64  m_FilterDeviation;
+    
+    float   m_sampleRate;   // of the core
     float   m_vTuning;
     
+    // host rate, m_RateFactor times the core's when m_ResampleHighRates
+    Float64 m_hostRate;
+    UInt32  m_RateFactor;
+    bool    m_ResampleHighRates;
+    UInt32  core_rate_factor(Float64 sampleRate);
+    void    set_core_rate(Float64 sampleRate);
+    UInt32  host_latency();
+    
+    void apply_params(tVTuningParams *parms);
+    void render_core(float **pin, float **pout, UInt32 nchan,
+                     UInt32 nel, bool replace);
+    void render_resampled(float **pin, float **pout, UInt32 nchan,
+                          UInt32 nel, bool replace);
+    
+    // weighted overlap-add engine in place of overlap-save
+    bool    m_WOLA;
+    Float64 m_selfCalHann;
+    Float64 m_selfCalSine;
+    
     void init_datawin();
+    void init_filter_kernel();
     void fill_bark_interpolation_tables();
-    void fill_bark_tables();
-    void fill_ft_tables();
-    void interpolate_eqStruct(t_EQStruct *eqtbl, Float64 *dst, tAmplFn *pfn, bool norm1kHz = true);
+    void set_eq_curve(const TEQCurve *&slot, t_EQStruct *eqtbl, tAmplFn *pfn, bool norm1kHz = true);
     void compute_inverse_ATH_filter();
     void invalidate_unified_filter();
     void ensure_unified_filter();
@@ -148,35 +383,108 @@ class TCrescendo
     {
         m_AudioFFT->set_FT_Nyquist(ft, re);
     }
-    // --------------------------------------------------------------
-
-    
-public:
     
-    Float64* get_PowerSpectrum()
-	{ return m_PowerSpectrum(); }
+    inline Float64 power_prefix_sum(const Float64 *ft, const Float64 *wts, Float64 *dst, UInt32 ncells)
+    {
+        return m_AudioFFT->power_prefix_sum(ft, wts, dst, ncells);
+    }
     
-	Float64* get_BarkSpectrum()
-	{ return m_BarkSpectrum; }
+    inline Float64 power_prefix_sum(const Float32 *ft, const Float64 *wts, Float64 *dst, UInt32 ncells)
+    {
+        return m_AudioFFT->power_prefix_sum(ft, wts, dst, ncells);
+    }
     
-	Float64* get_BarkGains()
-	{ return m_BarkGains; }
+    inline void set_real_gains(Float64 *ft, const Float64 *gains, UInt32 ncells)
+    {
+        m_AudioFFT->set_real_gains(ft, gains, ncells);
+    }
+    // --------------------------------------------------------------
+
     
-	Float64* get_Data()
-	{ return m_Data(); }
+public:
     
+    SHARED_VAR(UInt32,   fftOrder);
     SHARED_VAR(UInt32,   blksize);
     SHARED_VAR(UInt32,   hblksize);
     SHARED_VAR(UInt32,   qblksize);
     
-	SHARED_VAR(Float64*, HdphEQ);
-    SHARED_VAR(Float64*, PostEQ);
-    SHARED_VAR(Float64*, PreEQ);
-    SHARED_VAR(Float64*, PreEQAmpl);
     
     SHARED_VAR(bool,     Processing);
     // SHARED_VAR(bool,     CorrectionsOnly);
     
+    // one forward FFT per hop, see render_samples()
+    SHARED_VAR(bool,     ReuseDataFFT);
+    
+    // build the filter by spectral smoothing, see compute_filter()
+    SHARED_VAR(bool,     SpectralFilter);
+    
+    // transform L and R together, see render_samples_stereo()
+    SHARED_VAR(bool,     StereoFFT);
+    
+    // one analysis and one filter for both channels, kStereoLinkMax or
+    // kStereoLinkMean, see render_samples_stereo(). Implies StereoFFT.
+    SHARED_VAR(UInt32,   StereoLink);
+    
+    // table lookup in place of the rational fits, see compute_hcgain()
+    bool get_GainTables()
+    { return m_GainTables; }
+    void set_GainTables(bool arg);
+    
+    // all bands at once in vector lanes, see compute_bark_gains_vector()
+    SHARED_VAR(bool,     VectorBarkGains);
+    
+    // polynomial dB conversions in place of libm, see vdb10() and vampl20()
+    SHARED_VAR(bool,     FastDBMath);
+    
+    // power estimation in single precision, see compute_power_spectrum()
+    // The ReuseDataFFT and StereoFFT paths share their spectrum with the
+    // filter and stay in double.
+    SHARED_VAR(bool,     FloatAnalysis);
+    
+    // restart the channels' dither streams, for reproducible output
+    void set_DitherSeed(UInt32 seed);
+    
+    // attack/release without denormal dither, relying on the DAZFZ
+    // guard in render(). Ignored where DAZFZ is not available.
+    bool get_PlainRelax()
+    { return m_PlainRelax; }
+    void set_PlainRelax(bool arg);
+    
+    // channels in step through the band powers, the gains and the cell
+    // gains side by side in vector lanes, see render_samples_lanes().
+    // Overlap-save only, it stands aside for WOLA, ReuseDataFFT and the
+    // stereo pairs. The gains come out as with VectorBarkGains.
+    // Call from the control thread, never while render() is running.
+    bool get_ChannelLanes()
+    { return m_ChannelLanes; }
+    void set_ChannelLanes(bool arg);
+    
+    // render L and R on two threads, see render()
+    bool get_ParallelChannels()
+    { return m_ParallelChannels; }
+    void set_ParallelChannels(bool arg);
+    
+    // one forward and one inverse FFT per hop, see render_samples_wola().
+    // Select before processing, latency is one block instead of 5/4.
+    bool get_WOLA()
+    { return m_WOLA; }
+    void set_WOLA(bool arg);
+    
+    // at 88.2 kHz and up, run the core at 44.1 or 48 kHz between a
+    // decimator and an interpolator, see render_resampled().
+    // Call from the control thread, never while render() is running.
+    bool get_ResampleHighRates()
+    { return m_ResampleHighRates; }
+    void set_ResampleHighRates(bool arg);
+    
+    // host samples per core sample
+    UInt32 get_RateFactor()
+    { return m_RateFactor; }
+    
+    // where render_samples() leaves the next half block of output
+    UInt32 get_output_offset()
+    { return (m_WOLA ? 0 : m_qblksize); }
+    
     SHARED_VAR(UInt32,   HoldCt);
     SHARED_VAR(Float64,  ReleaseFast);
     SHARED_VAR(Float64,  ReleaseSlow);
@@ -216,6 +524,24 @@ public:
                 UInt32 nel, bool replace,
                 tVTuningParams *parms);
     
+    // Planar I/O, one buffer per channel. Channels are taken in pairs,
+    // (0,1), (2,3) ..., for StereoFFT and StereoLink, so lay out a bed
+    // with its left/right pairs together. With ChannelLanes they are
+    // taken VD_LANES at a time, (0..3), (4..7) with AVX, and with
+    // ParallelChannels the worker then takes whole lane blocks.
+    UInt32 get_NumChannels()
+    { return m_nchans; }
+    TCrescendo_bark_channel* get_channel(UInt32 ix);
+    void set_NumChannels(UInt32 nchan);   // control thread only
+    void render_planar(float **pin, float **pout, UInt32 nchan,
+                       UInt32 nel, bool replace,
+                       tVTuningParams *parms);
+    
+    // channels first to last-1 of a planar rendering
+    void render_range(float **pin, float **pout,
+                      UInt32 first, UInt32 last,
+                      UInt32 nel, bool replace);
+    
 #ifdef MACOS
 	Float64 get_latency();
 #else
@@ -223,23 +549,59 @@ public:
 #endif
     
     Float64 get_power();
+    
+    // worst case deviation of the SpectralFilter from the reference
+    // filter, relative to the peak filter gain
+    Float64 get_FilterDeviation()
+    { return m_FilterDeviation; }
+    Float64 measure_filter_deviation();
+    
+    // largest difference in dB between the vector and scalar Bark
+    // gains, both run from the same band state
+    Float64 measure_vector_gains();
+    
+    // largest difference in dB between the FloatAnalysis band powers
+    // and the double ones, for a power estimation segment
+    Float64 measure_float_analysis(Float64 *seg);
+    
 	void get_levels(Float64 &lrms, Float64 &rrms);
+    Float64 get_level(UInt32 chan);
     
     Float64 convert_dBFS_to_dBSPL(Float64 pdb)
     { return (pdb + m_CaldBSPL - (m_CaldBFS - 3.0)); }
     
 	Float64 compute_bark_powers(Float64 *pwr_spectrum, Float64 *bk_pwr);
+	Float64 compute_bark_powers(Float32 *pwr_spectrum, Float64 *bk_pwr);
+    void    split_bark_powers(Float64 *ft_pwr, Float64 *bk_pwr);
     void    compute_ft_gains(Float64 *bark_gains, Float64 *ft_buf);
-    void    render_samples(Float64 *pin, Float64 *pout, TCrescendo_bark_channel *chan);
+    void    render_samples(Float64 *pin, TCrescendo_bark_channel *chan);
+    void    render_samples_wola(Float64 *pin, TCrescendo_bark_channel *chan);
+    void    render_samples_stereo(Float64 *pinL, Float64 *pinR,
+                                  TCrescendo_bark_channel *lchan,
+                                  TCrescendo_bark_channel *rchan);
+    void    render_samples_fanout(Float64 *pin, TCrescendo_bark_channel *src,
+                                  TCrescendo **profiles, UInt32 nprof);
+    void    render_samples_lanes(bark_lanes *lw, Float64 **pin);
+    void    compute_bark_powers_lanes(bark_lanes *lw);
+    void    compute_filters_lanes(bark_lanes *lw);
+    void    overlap_add(Float64 *data, TCrescendo_bark_channel *chan);
     Float64 dbfs_to_dbhl(Float64 pwrfs, Float64 fletch);
     
 	void    update_filter(Float64 *pin, TCrescendo_bark_channel *chan);
 	void    compute_power_spectrum(Float64 *pin, TCrescendo_bark_channel *chan);
+	void    compute_reusable_spectrum(Float64 *pin, Float64 *spec, TCrescendo_bark_channel *chan);
+	void    window_spectrum(Float64 *spec, Float64 *pwr_spectrum);
 	void    update_bark_powers(TCrescendo_bark_channel *chan);
-	void    compute_filter();
+	void    update_bark_powers(TCrescendo_bark_channel *chan, Float64 *pwr_spectrum);
+	void    update_bark_powers(TCrescendo_bark_channel *chan, Float32 *pwr_spectrum);
+	void    compute_filter(TCrescendo_workspace *ws);
+	void    truncate_filter(TCrescendo_workspace *ws, Float64 *gains, Float64 *filter);
+	void    compute_filter_reference(TCrescendo_workspace *ws, Float64 *filter);
+	void    compute_filter_spectral(TCrescendo_workspace *ws, Float64 *filter);
 	Float64 compute_cumulative_power(Float64 *pwr_spectrum, Float64 *ft_pwr);
     
-    void self_calibrate();
+    void    self_calibrate();
+    Float64 calibrate_window(Float64 *pwin);
 };
 
 // -------------------------------------------------------------------------
@@ -247,25 +609,58 @@ public:
 #define REF_PARENT(type, name) \
 type get_##name() { return (type)(m_parent->get_##name()); }
 
-class TCrescendo_bark_channel
+class TCrescendo_bark_channel : public TCrescendo_workspace
 {
 	TCrescendo *m_parent;
     
 	UInt32 m_blksize;
 	
 	// data for each Bark band
-	bark_rec m_bark[NSUBBANDS*NFBANDS+1];
+	bark_bands m_bands;
+    Float32    m_vTune;           // what m_bands was tuned for
+    bark_lanes *m_LaneHome;       // holds the band state when set
+    UInt32      m_Lane;
+    
+    // Gain tables, double buffered. The audio thread reads the
+    // published one while the builder fills the other.
+    UInt32       m_bandsSerial;   // bumped by set_vtuning
+    gain_tables  m_GainTables[2];
+    gain_tables *m_BuildTables;
+    std::atomic<gain_tables*> m_PublishedTables;
+    const gain_tables *m_ActiveTables;  // for this hop
+    UInt32       m_TableHops;     // hops since the last vtune change
 	
-	// the buffer used to accumulate input data and scraps
+	// the buffer used to accumulate input data and scraps -- three
+	// half blocks and a mirror of the first, so that any two successive
+	// half blocks are contiguous, see save_input()
 	DZPtr   m_ibuf;
 	UInt32  m_ioff;
 	UInt32  m_iscrap;
 	
+	// rate conversion when the parent runs the core below the host rate
+	TPtr<TResampler> m_Resampler;
+	
 	// the output circular buffer used to handle non-pwr-of-2 renderings
 	// we always write half frames, but reads can be anything that size
 	// or less.
 	TPtr<TCircbuf> m_obuf;
     
+	// unwindowed spectra of the last two power-estimation segments,
+	// for use when the parent is in ReuseDataFFT mode
+	DZPtr     m_SpecCache;
+	Float64  *m_PrevSpec;
+	Float64  *m_NextSpec;
+	bool      m_PrevSpecValid;
+    
+	// second half of the last synthesized frame, for the WOLA engine
+	DZPtr     m_Overlap;
+    
+	// private dither streams, so channels may run on separate threads.
+	// Output has a stream of its own, apart from the relaxations, so
+	// render_aligned() may write output ahead of the analysis.
+	TDither   m_Dither;
+	TDither   m_OutDither;
+    
 	Float64   m_level;
     Float64   m_Crest;
     TPtr<TOrd4Filter>  m_crestFilter;
@@ -277,9 +672,43 @@ public:
     int get_ioff()
     { return m_ioff; }
     
+    // true when both channels sit at the same point in their hops
+    bool in_step_with(TCrescendo_bark_channel *other)
+    { return (m_ioff == other->m_ioff && m_iscrap == other->m_iscrap); }
+    
+    // true when both channels have the same band coefficients
+    bool same_tuning(TCrescendo_bark_channel *other)
+    { return (m_vTune == other->m_vTune); }
+    
     Float64 get_level()
     { return m_level; }
     
+    TResampler* get_Resampler()
+    { return m_Resampler(); }
+    
+    Float64* get_NextSpectrum()
+    { return m_NextSpec; }
+    
+    Float64* get_PrevSpectrum()
+    { return (m_PrevSpecValid ? m_PrevSpec : 0); }
+    
+    void rotate_spectra()
+    {
+        Float64 *p = m_PrevSpec;
+        m_PrevSpec = m_NextSpec;
+        m_NextSpec = p;
+        m_PrevSpecValid = true;
+    }
+    
+    void invalidate_spectra()
+    { m_PrevSpecValid = false; }
+    
+    Float64* get_Overlap()
+    { return m_Overlap(); }
+    
+    void reset_overlap()
+    { dzero(m_Overlap(), m_parent->get_hblksize()); }
+    
     REF_PARENT(UInt32,      blksize);
     REF_PARENT(UInt32,      hblksize);
     REF_PARENT(UInt32,      qblksize);
@@ -299,25 +728,85 @@ public:
     REF_PARENT(Float64,  ReleaseSlow);
     REF_PARENT(Float64,  GainRelease);
     
-    REF_PARENT(Float64*, BarkSpectrum);
-	REF_PARENT(Float64*, BarkGains);
-	REF_PARENT(Float64*, Data);
-    
     REF_PARENT(Float64, selfCalSF);
     
+    void seed_dither(UInt32 seed, UInt32 stream)
+    { m_Dither.seed(seed, 2*stream);
+      m_OutDither.seed(seed, 2*stream+1);
+      m_Dither.set_plain_relax(m_parent->get_PlainRelax()); }
+    
+    void set_plain_relax(bool arg)
+    { m_Dither.set_plain_relax(arg); }
+    
+    REF_PARENT(bool,    VectorBarkGains);
+    REF_PARENT(bool,    FastDBMath);
+    
     void    render_channel(float *pin, float *pout, UInt32 nel, bool replace);
+    void    render_channel_pair(TCrescendo_bark_channel *right,
+                                float *pinL, float *pinR,
+                                float *poutL, float *poutR,
+                                UInt32 nel, bool replace);
+    
+    // whole hops back to back, for calls that start on a hop boundary
+    // and cover a whole number of hops, see render_channel()
+    void    render_aligned(float *pin, float *pout, UInt32 nel, bool replace);
+    void    render_aligned_pair(TCrescendo_bark_channel *right,
+                                float *pinL, float *pinR,
+                                float *poutL, float *poutR,
+                                UInt32 nel, bool replace);
+    
+    // the channels in lw->chan, in step and on the same tuning, in
+    // lockstep, buffers by lane
+    static void render_channel_lanes(bark_lanes *lw, float **pin, float **pout,
+                                     UInt32 nel, bool replace);
+    
+    // The band state moves into the lane block for the lanes path and
+    // stays there until the channel is next processed any other way.
+    // Both are no-ops when it is already where it should be.
+    void    enter_lanes(bark_lanes *lw, UInt32 lane);
+    void    leave_lanes();
+    
+    // as source for a TCrescendo_fanout, the input is ours and the
+    // output goes to channel 0 of each profile
+    void    render_channel_fanout(TCrescendo **profiles, UInt32 nprof,
+                                  float *pin, float **pout,
+                                  UInt32 nel, bool replace);
+    void    emit_output(Float64 *psrc, Float32 *pout, UInt32 nel, bool replace);
+    
 	void    set_vtuning(float vtune);
 	void    SetSampleRate(Float64 sampleRate);
-	Float64 compute_hcgain(Float64 dbpwr, bark_rec *pbark);
+	Float64 compute_hcgain(Float64 dbpwr, UInt32 ix);
+    
+    // gain tables: prepare on the audio thread, between renders,
+    // then build on the builder thread
+    bool    gain_tables_stale();
+    void    prepare_gain_tables();
+    void    build_gain_tables();
+    void    restart_gain_tables()
+    { m_TableHops = 0; }
+    const gain_tables* get_PublishedTables()
+    { return m_PublishedTables.load(std::memory_order_acquire); }
     void    compute_crest_factor(Float64 *pdata, UInt32 nel);
     
+	void    compute_bark_levels(Float64 *xdb, UInt32 nbands);
+	void    link_bark_powers(TCrescendo_bark_channel *other, UInt32 mode);
+	void    share_crest_factor(TCrescendo_bark_channel *src)
+	{ m_Crest = src->m_Crest; }
 	void    compute_bark_gains();
-	void    select_data_for_power_estimation(Float64 *pin,
-                                             Float64 *pwr_spectrum,
-                                             UInt32  hblksize);
-	void    select_data_for_filtering(Float64 *pin,
-                                      Float64 *data,
-                                      UInt32   hblksize);
+	void    compute_bark_gains_scalar();
+	void    compute_bark_gains_vector();
+    static void compute_bark_gains_lanes(bark_lanes *lw);
+    Float64 measure_vector_gains();
+    void    save_input(Float32 *pin, UInt32 nel);
+    
+    // pin is the input buffer, m_ioff the half block just filled.
+    // The power estimation segment ends with it, the filtering
+    // segment ends one half block earlier. Both are 2*hblksize long.
+    Float64* power_segment(Float64 *pin, UInt32 hblksize)
+    { return pin + ((m_ioff + 2) % 3)*hblksize; }
+    
+    Float64* filter_segment(Float64 *pin, UInt32 hblksize)
+    { return pin + ((m_ioff + 1) % 3)*hblksize; }
     
 	void update_level(Float64 total_pwr);
 
@@ -329,6 +818,67 @@ public:
 };
 
 
+// -------------------------------------------------------------
+// One program feed rendered for many listeners, each with a hearing
+// profile of their own: vTune, headphone and post EQ, volume. Each
+// profile is a whole TCrescendo, but the feed is buffered, transformed
+// and measured once per hop by m_Source, and only the gains, the filter
+// and the inverse transform run per profile. Profiles on the same EQ
+// share their band powers too. See TCrescendo::render_samples_fanout().
+//
+// WOLA and FloatAnalysis decide how the shared spectrum is made, and
+// each profile calibrates its band powers for them, so they are set
+// here for all profiles. render() puts back any set on a profile
+// directly. ReuseDataFFT, StereoFFT and ResampleHighRates do not apply.
+
+#define CRESCENDO_MAX_PROFILES  64
+
+class TCrescendo_fanout
+{
+    TPtr<TCrescendo> m_profiles[CRESCENDO_MAX_PROFILES];
+    UInt32           m_nprofiles;
+    
+    // input history and the shared transforms, parented by profile 0
+    TPtr<TCrescendo_bark_channel> m_Source;
+    
+    bool             m_WOLA;
+    bool             m_FloatAnalysis;
+    
+    void apply_options(TCrescendo *prof);
+    
+public:
+    TCrescendo_fanout(Float64 sampleRate, UInt32 nprofiles);
+    virtual ~TCrescendo_fanout();
+    
+    UInt32 get_NumProfiles()
+    { return m_nprofiles; }
+    
+    TCrescendo* get_profile(UInt32 ix)
+    { return m_profiles[ix](); }
+    
+    void SetSampleRate(Float64 sampleRate);
+    void set_DitherSeed(UInt32 seed);
+    
+    // engine options for every profile, see above
+    bool get_WOLA()
+    { return m_WOLA; }
+    void set_WOLA(bool arg);
+    bool get_FloatAnalysis()
+    { return m_FloatAnalysis; }
+    void set_FloatAnalysis(bool arg);
+    
+    // pout[ix] and parms[ix] belong to profile ix, parms may be null
+    void render(float *pin, float **pout, UInt32 nel, bool replace,
+                tVTuningParams **parms);
+    
+#ifdef MACOS
+	Float64 get_latency();
+#else
+	UInt32 get_latency();
+#endif
+    Float64 get_level(UInt32 ix);
+};
+
 // ---------------------------------------------
 
 #endif // __CRESCENDO_H__
@@ -57,7 +57,41 @@ void** T3FA97C32_B233_11E0_A3DE_0017F2CCD25E()
         (void*)RAL_crescendo_processor_process,
         
         (void*)RAL_crescendo_processor_get_latency,
-        (void*)RAL_crescendo_processor_get_power        
+        (void*)RAL_crescendo_processor_get_power,
+        
+        // revision 2, see crescendo_dsp.h, appended so the slots
+        // above keep their places
+        
+        // planar beds
+        (void*)RAL_crescendo_processor_set_channels,
+        (void*)RAL_crescendo_processor_process_planar,
+        
+        // one feed, many hearing profiles
+        (void*)RAL_make_crescendo_fanout,
+        (void*)RAL_discard_crescendo_fanout,
+        (void*)RAL_crescendo_fanout_set_sample_rate,
+        (void*)RAL_crescendo_fanout_process,
+        (void*)RAL_crescendo_fanout_get_latency,
+        
+        // many independent streams on a thread pool
+        (void*)RAL_make_stream_host,
+        (void*)RAL_discard_stream_host,
+        (void*)RAL_stream_host_get_processor,
+        (void*)RAL_stream_host_start,
+        (void*)RAL_stream_host_stop,
+        (void*)RAL_stream_host_get_hop,
+        (void*)RAL_stream_host_set_params,
+        (void*)RAL_stream_host_push,
+        (void*)RAL_stream_host_pull,
+        (void*)RAL_stream_host_get_stats,
+        (void*)RAL_stream_host_get_total_stats,
+        
+        // revision, batches
+        (void*)RAL_crescendo_abi_version,
+        (void*)RAL_make_crescendo_batch,
+        (void*)RAL_discard_crescendo_batch,
+        (void*)RAL_crescendo_batch_process,
+        (void*)RAL_crescendo_processor_get_powers
     };
     return entryPoints;
 }
@@ -121,6 +155,135 @@ Float64 RAL_crescendo_processor_get_power(void *pcresc)
     return ((TCrescendo*)pcresc)->get_power();
 }
 
+void   RAL_crescendo_processor_set_channels(void *pcresc, UInt32 nchan)
+{
+    ((TCrescendo*)pcresc)->set_NumChannels(nchan);
+}
+
+void   RAL_crescendo_processor_process_planar(void *pcresc,
+                                              Float32 **pin, Float32 **pout,
+                                              UInt32 nchan, UInt32 nel, bool replace,
+                                              tVTuningParams *parms)
+{
+    ((TCrescendo*)pcresc)->render_planar(pin, pout, nchan, nel, replace, parms);
+}
+
+// ----------------------------------------------------
+
+void*  RAL_make_crescendo_fanout(Float32 sampleRate, UInt32 nprofiles)
+{
+    return new TCrescendo_fanout(sampleRate, nprofiles);
+}
+
+void   RAL_discard_crescendo_fanout(void *pfan)
+{
+    delete((TCrescendo_fanout*)pfan);
+}
+
+void   RAL_crescendo_fanout_set_sample_rate(void *pfan, Float32 sampleRate)
+{
+    ((TCrescendo_fanout*)pfan)->SetSampleRate(sampleRate);
+}
+
+void   RAL_crescendo_fanout_process(void *pfan,
+                                    Float32 *pin, Float32 **pout,
+                                    UInt32 nel, bool replace,
+                                    tVTuningParams **parms)
+{
+    ((TCrescendo_fanout*)pfan)->render(pin, pout, nel, replace, parms);
+}
+
+Float64 RAL_crescendo_fanout_get_latency(void *pfan)
+{
+    return ((TCrescendo_fanout*)pfan)->get_latency();
+}
+
+// ----------------------------------------------------
+
+void*  RAL_make_stream_host(UInt32 nstreams, Float32 sampleRate, UInt32 nthreads)
+{
+    return new TStreamHost(nstreams, sampleRate, nthreads);
+}
+
+void   RAL_discard_stream_host(void *phost)
+{
+    delete((TStreamHost*)phost);
+}
+
+void*  RAL_stream_host_get_processor(void *phost, UInt32 ix)
+{
+    return ((TStreamHost*)phost)->get_processor(ix);
+}
+
+void   RAL_stream_host_start(void *phost)
+{
+    ((TStreamHost*)phost)->start();
+}
+
+void   RAL_stream_host_stop(void *phost)
+{
+    ((TStreamHost*)phost)->stop();
+}
+
+UInt32 RAL_stream_host_get_hop(void *phost, UInt32 ix)
+{
+    return ((TStreamHost*)phost)->get_hop(ix);
+}
+
+void   RAL_stream_host_set_params(void *phost, UInt32 ix, tVTuningParams *parms)
+{
+    ((TStreamHost*)phost)->set_params(ix, parms);
+}
+
+bool   RAL_stream_host_push(void *phost, UInt32 ix, Float32 *inL, Float32 *inR)
+{
+    return ((TStreamHost*)phost)->push(ix, inL, inR);
+}
+
+bool   RAL_stream_host_pull(void *phost, UInt32 ix, Float32 *outL, Float32 *outR)
+{
+    return ((TStreamHost*)phost)->pull(ix, outL, outR);
+}
+
+void   RAL_stream_host_get_stats(void *phost, UInt32 ix, tStreamStats *stats)
+{
+    ((TStreamHost*)phost)->get_stats(ix, stats);
+}
+
+void   RAL_stream_host_get_total_stats(void *phost, tStreamStats *stats)
+{
+    ((TStreamHost*)phost)->get_total_stats(stats);
+}
+
+// ----------------------------------------------------
+
+unsigned int RAL_crescendo_abi_version()
+{
+    return CRESCENDO_ABI_VERSION;
+}
+
+void*  RAL_make_crescendo_batch(UInt32 nthreads)
+{
+    return new TCrescendoBatch(nthreads);
+}
+
+void   RAL_discard_crescendo_batch(void *pbatch)
+{
+    delete((TCrescendoBatch*)pbatch);
+}
+
+SInt32 RAL_crescendo_batch_process(void *pbatch, const tCrescendoBatchItem *items,
+                                   UInt32 nitems, UInt32 item_size)
+{
+    return ((TCrescendoBatch*)pbatch)->process(items, nitems, item_size);
+}
+
+void   RAL_crescendo_processor_get_powers(void **pcresc, Float64 *powers, UInt32 n)
+{
+    for(UInt32 ix = 0; ix < n; ++ix)
+        powers[ix] = ((TCrescendo*)pcresc[ix])->get_power();
+}
+
 // ----------------------------------------------------
 
 
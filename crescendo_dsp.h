@@ -40,8 +40,41 @@
 
 #pragma GCC visibility push(default)
 
+// Revision of the entry table. Slots are only ever appended, so a
+// library of a later revision serves clients built for an earlier one.
+// Look up RAL_crescendo_abi_version() by name before using any slot past
+// 9: a library without it is revision 1, and its table ends at slot 9.
+//
+//   1   slots  0-9    crossover and single instance calls
+//   2   slots 10-32   planar, fan-out, stream host, revision, batches
+#define CRESCENDO_ABI_VERSION   2
+
+struct tVTuningParams;
+
+// One processor call of a batch, as RAL_crescendo_processor_process().
+// Batches pass their item size, so that later revisions may add fields
+// at the end and still take arrays laid out by earlier clients.
+//
+// A batch handle, from RAL_make_crescendo_batch(), keeps the batch in
+// progress in itself: call RAL_crescendo_batch_process() on it from one
+// thread at a time, and give each thread a handle of its own. A batch
+// with more items than any before it allocates the handle's grouping
+// scratch with new[], so run one of the full size before going real
+// time.
+typedef struct tCrescendoBatchItem {
+    void                  *instance;    // from RAL_make_crescendo_processor()
+    float                 *pinL;
+    float                 *pinR;        // null for mono
+    float                 *poutL;
+    float                 *poutR;
+    unsigned int           nel;
+    unsigned int           replace;     // nonzero to overwrite, else accumulate
+    struct tVTuningParams *parms;       // may be null
+} tCrescendoBatchItem;
+
 extern "C" {
     extern void** T3FA97C32_B233_11E0_A3DE_0017F2CCD25E();
+    extern unsigned int RAL_crescendo_abi_version();
 };
 
 #pragma GCC visibility pop
@@ -40,6 +40,8 @@
 
 #include "crescendo.h"
 #include "crossover.h"
+#include "tstreamhost.h"
+#include "tbatch.h"
 
 extern void*  RAL_make_headphone_crossover(Float32 sampleRate);
 extern void   RAL_discard_headphone_crossover(void *pcross);
@@ -61,6 +63,39 @@ extern void   RAL_crescendo_processor_process(void *pcresc, Float32 *pinL, Float
 extern Float64 RAL_crescendo_processor_get_latency(void *pcresc);
 extern Float64 RAL_crescendo_processor_get_power(void *pcresc);
 
+extern void   RAL_crescendo_processor_set_channels(void *pcresc, UInt32 nchan);
+extern void   RAL_crescendo_processor_process_planar(void *pcresc,
+                                                     Float32 **pin, Float32 **pout,
+                                                     UInt32 nchan, UInt32 nel, bool replace,
+                                                     tVTuningParams *parms);
+
+extern void*  RAL_make_crescendo_fanout(Float32 sampleRate, UInt32 nprofiles);
+extern void   RAL_discard_crescendo_fanout(void *pfan);
+extern void   RAL_crescendo_fanout_set_sample_rate(void *pfan, Float32 sampleRate);
+extern void   RAL_crescendo_fanout_process(void *pfan,
+                                           Float32 *pin, Float32 **pout,
+                                           UInt32 nel, bool replace,
+                                           tVTuningParams **parms);
+extern Float64 RAL_crescendo_fanout_get_latency(void *pfan);
+
+extern void*  RAL_make_stream_host(UInt32 nstreams, Float32 sampleRate, UInt32 nthreads);
+extern void   RAL_discard_stream_host(void *phost);
+extern void*  RAL_stream_host_get_processor(void *phost, UInt32 ix);
+extern void   RAL_stream_host_start(void *phost);
+extern void   RAL_stream_host_stop(void *phost);
+extern UInt32 RAL_stream_host_get_hop(void *phost, UInt32 ix);
+extern void   RAL_stream_host_set_params(void *phost, UInt32 ix, tVTuningParams *parms);
+extern bool   RAL_stream_host_push(void *phost, UInt32 ix, Float32 *inL, Float32 *inR);
+extern bool   RAL_stream_host_pull(void *phost, UInt32 ix, Float32 *outL, Float32 *outR);
+extern void   RAL_stream_host_get_stats(void *phost, UInt32 ix, tStreamStats *stats);
+extern void   RAL_stream_host_get_total_stats(void *phost, tStreamStats *stats);
+
+extern void*  RAL_make_crescendo_batch(UInt32 nthreads);
+extern void   RAL_discard_crescendo_batch(void *pbatch);
+extern SInt32 RAL_crescendo_batch_process(void *pbatch, const tCrescendoBatchItem *items,
+                                          UInt32 nitems, UInt32 item_size);
+extern void   RAL_crescendo_processor_get_powers(void **pcresc, Float64 *powers, UInt32 n);
+
 // ---------------------------------------------------------------
 
 #pragma GCC visibility pop
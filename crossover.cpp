@@ -79,8 +79,7 @@ void TCrossOver::SetSampleRate(Float64 sampleRate)
 // -------------------------------------------------------------------------------------
 void TCrossOver::filter(Float32 *pinL, Float32 *pinR, Float32 *poutL, Float32 *poutR, UInt32 nsamp)
 {
-    TDither dithL(nsamp);
-    TDither dithR(nsamp);
+    DAZFZ env;
     
 	// dereference instance vars into faster locals
 	for (int ix = nsamp; --ix >= 0;)
@@ -96,8 +95,8 @@ void TCrossOver::filter(Float32 *pinL, Float32 *pinR, Float32 *poutL, Float32 *p
 		Float64 sampRBPF = m_bpfR->filter(fDlyR);
 		Float64 sampRHS  = m_hishelfR->filter(fDlyR);
         
-        *poutL++ = dithL.cvt_dtos(fSrcL + m_xatten * (sampRBPF + sampRHS));
-        *poutR++ = dithR.cvt_dtos(fSrcR + m_xatten * (sampLBPF + sampLHS));
+        *poutL++ = m_dithL.cvt_dtos(fSrcL + m_xatten * (sampRBPF + sampRHS));
+        *poutR++ = m_dithR.cvt_dtos(fSrcR + m_xatten * (sampLBPF + sampLHS));
         
 		// for testing
 		//poutl[ix] = (float)(0*fSrcL + /* m_xatten * */ (sampLBPF + sampLHS));
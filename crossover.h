@@ -41,6 +41,7 @@
 #include "smart_ptr.h"
 #include "TDelay.h"
 #include "TFilter.h"
+#include "old-dither.h"
 
 class TCrossOver
 {
@@ -63,6 +64,9 @@ public:
 	TPtr<TFilter> m_hishelfR;
 
 	Float64 m_xatten;
+
+	TDither m_dithL;
+	TDither m_dithR;
 };
 
 #endif // __CROSSOVER_H__
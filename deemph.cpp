@@ -486,14 +486,10 @@ Float64 identity_Float64(Float64 v)
 
 void TCrescendo::set_postEQ(t_EQStruct *eqtbl, bool force)
 {
-    static Float64 postEQ[129];
-    
     if((eqtbl != m_PostEQ_basis) || force)
     {
-        interpolate_eqStruct(eqtbl, postEQ, &identity_Float64);
+        set_eq_curve(m_EQParts[kEQ_Post], eqtbl, &identity_Float64);
         m_PostEQ_basis = eqtbl;
-        m_PostEQ = postEQ;
-        invalidate_unified_filter();
     }
 }
 
@@ -659,13 +655,7 @@ t_EQStruct gDMHyperCorrEQ = {
 
 void TCrescendo::set_preEQ()
 {
-    static Float64 preEQ[129];
-    static Float64 preEQAmpl[129];
-    
-    interpolate_eqStruct(&gDMHyperCorrEQ, preEQ, &identity_Float64, false);
-    m_PreEQ = preEQ;
-    interpolate_eqStruct(&gDMHyperCorrEQ, preEQAmpl, &ampl10, false);
-    m_PreEQAmpl = preEQAmpl;
-    invalidate_unified_filter();
+    set_eq_curve(m_EQParts[kEQ_Pre], &gDMHyperCorrEQ, &identity_Float64, false);
+    set_eq_curve(m_EQParts[kEQ_PreAmpl], &gDMHyperCorrEQ, &ampl10, false);
 }
 
@@ -348,8 +348,7 @@ Float64 invAmpl10(Float64 v)
 
 void TCrescendo::compute_inverse_ATH_filter()
 {
-    interpolate_eqStruct(&gATH, m_InvATH, &invAmpl10);
-    invalidate_unified_filter();
+    set_eq_curve(m_EQParts[kEQ_InvATH], &gATH, &invAmpl10);
 }
 
 
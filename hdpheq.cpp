@@ -29,6 +29,8 @@
  OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
  SUCH DAMAGE.
  ------------------------------------------------------------------------------- */
+#include <mutex>
+
 #include "Crescendo.h"
 #include "hdpheq.h"
 
@@ -1133,7 +1135,8 @@ t_EQStruct gNullEQ = {
 
 // -------------------------------------------------------------
 //
-void TCrescendo::interpolate_eqStruct(t_EQStruct *eqtbl, Float64 *dst, tAmplFn *pfn, bool norm1kHz)
+static void interpolate_eqStruct(t_EQStruct *eqtbl, Float64 *dst, Float64 sampleRate, UInt32 blksize,
+                                 tAmplFn *pfn, bool norm1kHz)
 {
 	int ix, jx, ctr;
     
@@ -1147,8 +1150,8 @@ void TCrescendo::interpolate_eqStruct(t_EQStruct *eqtbl, Float64 *dst, tAmplFn *
         frac -= nx;
         ref = (1.0 - frac) * eqtbl->db[nx] + frac * eqtbl->db[nx+1];
     }
-	int refill = m_sampleRate * eqtbl->nfft;
-	int dvsr   = eqtbl->fsamp * m_blksize;
+	int refill = sampleRate * eqtbl->nfft;
+	int dvsr   = eqtbl->fsamp * blksize;
 	int limit  = eqtbl->nfft / 2 + 1;
 	for(ix = 0, jx = 1, ctr = refill; ix < 129 && jx < limit; ++ix)
 	{
@@ -1165,16 +1168,170 @@ void TCrescendo::interpolate_eqStruct(t_EQStruct *eqtbl, Float64 *dst, tAmplFn *
 }
 
 // -------------------------------------------------------------------------------------
-void TCrescendo::set_headphone(t_EQStruct *eqtbl, bool force)
+// Cache of interned curves, one lock for curves and unified EQ's
+
+static std::mutex   gEQCacheLock;
+static TEQCurve    *gEQCurves  = 0;
+static TUnifiedEQ  *gUnifiedEQ = 0;
+
+TEQCurve::TEQCurve(t_EQStruct *eqtbl, Float64 sampleRate, UInt32 blksize,
+                   tAmplFn *pfn, bool norm1kHz)
+{
+    m_basis      = eqtbl;
+    m_sampleRate = sampleRate;
+    m_blksize    = blksize;
+    m_fn         = pfn;
+    m_norm1kHz   = norm1kHz;
+    m_refs       = 0;
+    m_next       = 0;
+    
+    memset(val, 0, sizeof(val));
+    interpolate_eqStruct(eqtbl, val, sampleRate, blksize, pfn, norm1kHz);
+}
+
+const TEQCurve *TEQCurve::acquire(t_EQStruct *eqtbl, Float64 sampleRate, UInt32 blksize,
+                                  tAmplFn *pfn, bool norm1kHz)
 {
-	static Float64 hdphEQ[129];
+    std::lock_guard<std::mutex> lock(gEQCacheLock);
+    
+    TEQCurve *curve;
+    for(curve = gEQCurves; curve; curve = curve->m_next)
+    {
+        if(curve->m_basis == eqtbl &&
+           curve->m_sampleRate == sampleRate &&
+           curve->m_blksize == blksize &&
+           curve->m_fn == pfn &&
+           curve->m_norm1kHz == norm1kHz)
+            break;
+    }
+    if(0 == curve)
+    {
+        curve = new TEQCurve(eqtbl, sampleRate, blksize, pfn, norm1kHz);
+        curve->m_next = gEQCurves;
+        gEQCurves = curve;
+    }
+    ++curve->m_refs;
+    return curve;
+}
+
+void TEQCurve::release_locked(const TEQCurve *curve)
+{
+    TEQCurve **pp;
+    for(pp = &gEQCurves; *pp; pp = &(*pp)->m_next)
+    {
+        TEQCurve *p = *pp;
+        if(p == curve)
+        {
+            if(0 == --p->m_refs)
+            {
+                *pp = p->m_next;
+                delete p;
+            }
+            return;
+        }
+    }
+}
+
+void TEQCurve::release(const TEQCurve *curve)
+{
+    if(0 == curve)
+        return;
+    
+    std::lock_guard<std::mutex> lock(gEQCacheLock);
+    release_locked(curve);
+}
+
+// -------------------------------------------------------------------------------------
+TUnifiedEQ::TUnifiedEQ(const TEQCurve **parts)
+{
+    m_refs = 0;
+    m_next = 0;
+    for(int ix = 0; ix < kEQ_NParts; ++ix)
+    {
+        m_parts[ix] = parts[ix];
+        ++((TEQCurve*)parts[ix])->m_refs;
+    }
+    
+    const Float64 *pATH  = parts[kEQ_InvATH]->val;
+    const Float64 *pPre  = parts[kEQ_PreAmpl]->val;
+    const Float64 *pHdph = parts[kEQ_Hdph]->val;
     
+    const Float64 *pPreDB  = parts[kEQ_Pre]->val;
+    const Float64 *pPostDB = parts[kEQ_Post]->val;
+    
+    for(UInt32 ix = 0; ix < 128; ++ix)
+    {
+        ampl[ix] = pATH[ix] * pPre[ix] * pHdph[ix];
+        dB[ix] = pPreDB[ix] - pPostDB[ix];
+    }
+}
+
+const TUnifiedEQ *TUnifiedEQ::acquire(const TEQCurve **parts)
+{
+    std::lock_guard<std::mutex> lock(gEQCacheLock);
+    
+    TUnifiedEQ *ueq;
+    for(ueq = gUnifiedEQ; ueq; ueq = ueq->m_next)
+    {
+        int ix;
+        for(ix = 0; ix < kEQ_NParts && ueq->m_parts[ix] == parts[ix]; ++ix)
+            ;
+        if(kEQ_NParts == ix)
+            break;
+    }
+    if(0 == ueq)
+    {
+        ueq = new TUnifiedEQ(parts);
+        ueq->m_next = gUnifiedEQ;
+        gUnifiedEQ = ueq;
+    }
+    ++ueq->m_refs;
+    return ueq;
+}
+
+void TUnifiedEQ::release(const TUnifiedEQ *ueq)
+{
+    if(0 == ueq)
+        return;
+    
+    std::lock_guard<std::mutex> lock(gEQCacheLock);
+    
+    TUnifiedEQ **pp;
+    for(pp = &gUnifiedEQ; *pp; pp = &(*pp)->m_next)
+    {
+        TUnifiedEQ *p = *pp;
+        if(p == ueq)
+        {
+            if(0 == --p->m_refs)
+            {
+                *pp = p->m_next;
+                for(int ix = 0; ix < kEQ_NParts; ++ix)
+                    TEQCurve::release_locked(p->m_parts[ix]);
+                delete p;
+            }
+            return;
+        }
+    }
+}
+
+// -------------------------------------------------------------------------------------
+// swap in a new curve for one of ours
+
+void TCrescendo::set_eq_curve(const TEQCurve *&slot, t_EQStruct *eqtbl, tAmplFn *pfn, bool norm1kHz)
+{
+    const TEQCurve *old = slot;
+    slot = TEQCurve::acquire(eqtbl, m_sampleRate, m_blksize, pfn, norm1kHz);
+    TEQCurve::release(old);
+    invalidate_unified_filter();
+}
+
+// -------------------------------------------------------------------------------------
+void TCrescendo::set_headphone(t_EQStruct *eqtbl, bool force)
+{
     if((eqtbl != m_HdphEQ_basis) || force)
     {
-        interpolate_eqStruct(eqtbl, hdphEQ, &ampl10);
+        set_eq_curve(m_EQParts[kEQ_Hdph], eqtbl, &ampl10);
         m_HdphEQ_basis = eqtbl;
-        m_HdphEQ = hdphEQ;
-        invalidate_unified_filter();
     }
 }
 
@@ -85,4 +85,65 @@ typedef struct t_EQStruct {
 
 extern t_EQStruct gNullEQ;
 
+// -------------------------------------------------------------
+// Interned EQ curves. An EQ table interpolated onto our FFT cells
+// depends only on the table, the sample rate, the block size and
+// the transfer function, so each distinct combination is built once
+// and shared, read-only, by every processor in the process.
+// Curves are reference counted, the last release frees them.
+// acquire() and release() take a lock, keep them off the audio thread
+// except when a curve actually changes.
+
+class TEQCurve
+{
+    t_EQStruct *m_basis;
+    Float64     m_sampleRate;
+    UInt32      m_blksize;
+    tAmplFn    *m_fn;
+    bool        m_norm1kHz;
+    UInt32      m_refs;
+    TEQCurve   *m_next;
+    
+    friend class TUnifiedEQ;
+    
+    TEQCurve(t_EQStruct *eqtbl, Float64 sampleRate, UInt32 blksize,
+             tAmplFn *pfn, bool norm1kHz);
+    
+    // release() with the cache lock already held
+    static void release_locked(const TEQCurve *curve);
+    
+public:
+    // values for the first 129 FFT cells
+    Float64 val[129];
+    
+    static const TEQCurve *acquire(t_EQStruct *eqtbl, Float64 sampleRate, UInt32 blksize,
+                                   tAmplFn *pfn, bool norm1kHz = true);
+    static void release(const TEQCurve *curve);
+};
+
+// The per-cell EQ applied by the engine, coalesced from its parts.
+// Keyed by the identity of the interned parts, which it holds
+// references to for as long as it lives.
+
+enum { kEQ_InvATH, kEQ_Pre, kEQ_PreAmpl, kEQ_Hdph, kEQ_Post, kEQ_NParts };
+
+class TUnifiedEQ
+{
+    const TEQCurve *m_parts[kEQ_NParts];
+    UInt32          m_refs;
+    TUnifiedEQ     *m_next;
+    
+    TUnifiedEQ(const TEQCurve **parts);
+    
+public:
+    // pre - post, dB
+    Float64 dB[128];
+    
+    // inverse ATH * pre * headphone, amplitude
+    Float64 ampl[128];
+    
+    static const TUnifiedEQ *acquire(const TEQCurve **parts);
+    static void release(const TUnifiedEQ *ueq);
+};
+
 #endif // __HDPHEQ_H__
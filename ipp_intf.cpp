@@ -75,9 +75,18 @@ void ipp_fft::init()
 	m_FFT_Order = 0;
 	m_FFT_Flag  = 0;
     m_blkSize   = 0;
+	m_FFTSpecF  = 0;
+	m_FFTBufF   = 0;
 #if MACOS
     m_DataBuf   = 0;
+    m_DataBufF  = 0;
+    m_StageBuf  = 0;
     m_hblkSize  = 0;
+#elif LINUX
+    m_StageBuf  = 0;
+    m_hblkSize  = 0;
+#elif WIN32
+    m_WinBufF   = 0;
 #endif
 }
 	
@@ -88,11 +97,23 @@ void ipp_fft::discard()
 #if WIN32
 		ippsFFTFree_R_64f(m_FFTSpec);
 		ippsFree(m_FFTBuf);
+		ippsFFTFree_R_32f(m_FFTSpecF);
+		ippsFree(m_FFTBufF);
+		ippsFree(m_WinBufF);
         
 #elif MACOS
         vDSP_destroy_fftsetupD(m_FFTSpec);
         free_align16(m_FFTBuf);
         free_align16(m_DataBuf);
+        vDSP_destroy_fftsetup(m_FFTSpecF);
+        free_align16(m_FFTBufF);
+        free_align16(m_DataBufF);
+
+#elif LINUX
+        TSimdFFT::release(m_FFTSpec);
+        delete [] m_FFTBuf;
+        TSimdFFTF::release(m_FFTSpecF);
+        delete [] m_FFTBufF;
 #endif
 	}
 }
@@ -108,7 +129,29 @@ void ipp_fft::init(UInt32 fft_order, UInt32 flag)
         m_hblkSize = (m_blkSize >> 1);
         m_FFTSpec = vDSP_create_fftsetupD(fft_order, FFT_RADIX2);
         m_FFTBuf  = (Float64*)alloc_align16(2*4*m_blkSize*sizeof(Float64));
-        m_DataBuf = (Float64*)alloc_align16(m_blkSize*sizeof(Float64));
+        m_DataBuf = (Float64*)alloc_align16(2*m_blkSize*sizeof(Float64));
+        m_StageBuf = m_DataBuf;
+        m_FFTSpecF = vDSP_create_fftsetup(fft_order, FFT_RADIX2);
+        m_FFTBufF  = (Float32*)alloc_align16(2*4*m_blkSize*sizeof(Float32));
+        m_DataBufF = (Float32*)alloc_align16(2*m_blkSize*sizeof(Float32));
+    }
+    m_FFT_Flag = flag;
+}
+
+#elif LINUX
+void ipp_fft::init(UInt32 fft_order, UInt32 flag)
+{
+	if(m_FFT_Order != fft_order)
+    {
+        discard();
+        m_FFT_Order = fft_order;
+        m_blkSize = (1 << fft_order);
+        m_hblkSize = (m_blkSize >> 1);
+        m_FFTSpec = TSimdFFT::acquire(fft_order);   // shared, see simd_fft.cpp
+        m_FFTBuf  = new Float64[m_FFTSpec->scratch_size() + 2*m_blkSize];
+        m_StageBuf = m_FFTBuf + m_FFTSpec->scratch_size();
+        m_FFTSpecF = TSimdFFTF::acquire(fft_order);
+        m_FFTBufF  = new Float32[m_FFTSpecF->scratch_size()];
     }
     m_FFT_Flag = flag;
 }
@@ -129,6 +172,11 @@ void ipp_fft::init(UInt32 fft_order, UInt32 flag)
 		m_FFTBuf = ippsMalloc_8u(bufsiz);
 
         m_blkSize = (1 << fft_order);
+        
+		ippsFFTInitAlloc_R_32f(&m_FFTSpecF, fft_order, flag, ippAlgHintFast);
+		ippsFFTGetBufSize_R_32f(m_FFTSpecF, &bufsiz);
+		m_FFTBufF = ippsMalloc_8u(bufsiz);
+		m_WinBufF = ippsMalloc_32f(m_blkSize);
     }
 }
 #endif
@@ -165,6 +213,10 @@ void ipp_fft::fwd(Float64 *buf)
             nspdbMpy1(0.5/m_blkSize,buf,m_blkSize);
             break;
     }
+
+#elif LINUX
+    Float64 scale = (IPP_FFT_DIV_FWD_BY_N == m_FFT_Flag) ? 1.0/m_blkSize : 1.0;
+    m_FFTSpec->rfft(buf, buf, scale, m_FFTBuf);
 #endif
 }
 
@@ -198,6 +250,193 @@ void ipp_fft::inv(Float64 *buf)
             nspdbMpy1(1.0/m_blkSize,buf,m_blkSize);
             break;
     }
+
+#elif LINUX
+    Float64 scale = (IPP_FFT_DIV_INV_BY_N == m_FFT_Flag) ? 1.0/m_blkSize : 1.0;
+    m_FFTSpec->rifft(buf, buf, scale, m_FFTBuf);
+#endif
+}
+
+void ipp_fft::fwd(const Float64 *src, Float64 *dst)
+{
+#if WIN32
+    ippsFFTFwd_RToPack_64f(src, dst, m_FFTSpec, m_FFTBuf);
+    
+#elif MACOS
+    // vDSP_ctozD already stages through m_DataBuf, so it may as
+    // well read from src
+    DSPDoubleSplitComplex tmp_data = 
+    { m_DataBuf, m_DataBuf + m_hblkSize };
+    DSPDoubleSplitComplex scratch = 
+    { m_FFTBuf, m_FFTBuf + 4*m_blkSize };
+    DSPDoubleSplitComplex cdst = 
+    { dst, dst + m_hblkSize };
+    
+    vDSP_ctozD((DSPDoubleComplex*)src, 2, &tmp_data, 1, m_hblkSize);
+    vDSP_fft_zroptD(m_FFTSpec, &tmp_data, 1, &cdst, 1, 
+               &scratch, m_FFT_Order, FFT_FORWARD);
+    switch(m_FFT_Flag)
+    {
+        case IPP_FFT_NODIV_BY_ANY:
+        case IPP_FFT_DIV_INV_BY_N:
+            nspdbMpy1(0.5,dst,m_blkSize);
+            break;
+            
+        case IPP_FFT_DIV_FWD_BY_N:
+            nspdbMpy1(0.5/m_blkSize,dst,m_blkSize);
+            break;
+    }
+
+#elif LINUX
+    Float64 scale = (IPP_FFT_DIV_FWD_BY_N == m_FFT_Flag) ? 1.0/m_blkSize : 1.0;
+    m_FFTSpec->rfft(src, dst, scale, m_FFTBuf);
+#endif
+}
+
+void ipp_fft::fwd_windowed(const Float64 *src, const Float64 *win, Float64 *dst, UInt32 ncells)
+{
+#if LINUX
+    // window folded into the even/odd split of the real transform
+    Float64 scale = (IPP_FFT_DIV_FWD_BY_N == m_FFT_Flag) ? 1.0/m_blkSize : 1.0;
+    m_FFTSpec->rfft_windowed(src, win, dst, scale, m_FFTBuf, ncells);
+#else
+    // the window product is the copy into dst
+    nspdbMpy3((Float64*)win, (Float64*)src, dst, m_blkSize);
+    fwd(dst);
+#endif
+}
+
+void ipp_fft::fwd_windowed(const Float64 *src, const Float64 *win, Float32 *dst, UInt32 ncells)
+{
+    // window product in double precision, transform in single
+#if WIN32
+    for(UInt32 ix = 0; ix < m_blkSize; ++ix)
+        m_WinBufF[ix] = (Float32)(win[ix] * src[ix]);
+    ippsFFTFwd_RToPack_32f(m_WinBufF, dst, m_FFTSpecF, m_FFTBufF);
+    
+#elif MACOS
+    DSPSplitComplex tmp_data = 
+    { m_DataBufF, m_DataBufF + m_hblkSize };
+    DSPSplitComplex scratch = 
+    { m_FFTBufF, m_FFTBufF + 4*m_blkSize };
+    DSPSplitComplex cdst = 
+    { dst, dst + m_hblkSize };
+    
+    vDSP_vmulD(src, 1, win, 1, m_DataBuf, 1, m_blkSize);
+    vDSP_vdpsp(m_DataBuf, 1, m_DataBufF + m_blkSize, 1, m_blkSize);
+    vDSP_ctoz((DSPComplex*)(m_DataBufF + m_blkSize), 2, &tmp_data, 1, m_hblkSize);
+    vDSP_fft_zrop(m_FFTSpecF, &tmp_data, 1, &cdst, 1, 
+              &scratch, m_FFT_Order, FFT_FORWARD);
+    Float32 scale = (IPP_FFT_DIV_FWD_BY_N == m_FFT_Flag) ? 0.5f/m_blkSize : 0.5f;
+    vDSP_vsmul(dst, 1, &scale, dst, 1, m_blkSize);
+    
+#elif LINUX
+    Float32 scale = (IPP_FFT_DIV_FWD_BY_N == m_FFT_Flag) ? 1.0f/m_blkSize : 1.0f;
+    m_FFTSpecF->rfft_windowed(src, win, dst, scale, m_FFTBufF, ncells);
+#endif
+}
+
+#if MACOS || LINUX
+void ipp_fft::split_spectra(Float64 *re, Float64 *im, Float64 scale)
+{
+    // re + i im holds C = L + i R, the complex transform of l + i r.
+    //   L[k] = (C[k] + C*[N-k]) / 2
+    //   R[k] = (C[k] - C*[N-k]) / 2i
+    // Each goes back over its own buffer in the split real layout.
+    Float64 *sl = m_StageBuf;
+    Float64 *sr = m_StageBuf + m_blkSize;
+    Float64  hscale = 0.5 * scale;
+    
+    sl[0] = scale * re[0];
+    sr[0] = scale * im[0];
+    sl[m_hblkSize] = scale * re[m_hblkSize];
+    sr[m_hblkSize] = scale * im[m_hblkSize];
+    for(UInt32 ix = 1; ix < m_hblkSize; ++ix)
+    {
+        Float64 ar = re[ix];
+        Float64 ai = im[ix];
+        Float64 br = re[m_blkSize-ix];
+        Float64 bi = im[m_blkSize-ix];
+        sl[ix]            = hscale * (ar + br);
+        sl[m_hblkSize+ix] = hscale * (ai - bi);
+        sr[ix]            = hscale * (ai + bi);
+        sr[m_hblkSize+ix] = hscale * (br - ar);
+    }
+    dcopy(sl, re, m_blkSize);
+    dcopy(sr, im, m_blkSize);
+}
+
+void ipp_fft::join_spectra(Float64 *bufL, Float64 *bufR, Float64 *re, Float64 *im)
+{
+    // C = L + i R over the full circle, from the Hermitian halves
+    re[0] = bufL[0];
+    im[0] = bufR[0];
+    re[m_hblkSize] = bufL[m_hblkSize];
+    im[m_hblkSize] = bufR[m_hblkSize];
+    for(UInt32 ix = 1; ix < m_hblkSize; ++ix)
+    {
+        Float64 lr = bufL[ix];
+        Float64 li = bufL[m_hblkSize+ix];
+        Float64 rr = bufR[ix];
+        Float64 ri = bufR[m_hblkSize+ix];
+        re[ix]           = lr - ri;
+        im[ix]           = li + rr;
+        re[m_blkSize-ix] = lr + ri;
+        im[m_blkSize-ix] = rr - li;
+    }
+}
+#endif
+
+void ipp_fft::fwd2(Float64 *bufL, Float64 *bufR)
+{
+#if WIN32
+    // no room for a complex transform in the packed layout
+    fwd(bufL);
+    fwd(bufR);
+    
+#else
+    Float64 scale = (IPP_FFT_DIV_FWD_BY_N == m_FFT_Flag) ? 1.0/m_blkSize : 1.0;
+#if MACOS
+    DSPDoubleSplitComplex c = { bufL, bufR };
+    DSPDoubleSplitComplex scratch = 
+    { m_FFTBuf, m_FFTBuf + 4*m_blkSize };
+    vDSP_fft_zoptD(m_FFTSpec, &c, 1, &scratch, m_FFT_Order, FFT_FORWARD);
+#else
+    m_FFTSpec->cfft(bufL, bufR, m_FFT_Order, m_FFTBuf);
+#endif
+    split_spectra(bufL, bufR, scale);
+#endif
+}
+
+void ipp_fft::inv2(Float64 *bufL, Float64 *bufR)
+{
+#if WIN32
+    inv(bufL);
+    inv(bufR);
+    
+#else
+    Float64 scale = (IPP_FFT_DIV_INV_BY_N == m_FFT_Flag) ? 1.0/m_blkSize : 1.0;
+    Float64 *cr = m_StageBuf;
+    Float64 *ci = m_StageBuf + m_blkSize;
+    
+    join_spectra(bufL, bufR, cr, ci);
+#if MACOS
+    DSPDoubleSplitComplex c = { cr, ci };
+    DSPDoubleSplitComplex scratch = 
+    { m_FFTBuf, m_FFTBuf + 4*m_blkSize };
+    vDSP_fft_zoptD(m_FFTSpec, &c, 1, &scratch, m_FFT_Order, FFT_INVERSE);
+#else
+    // inverse by way of swap(DFT(swap(C))), so the real
+    // part of the result lands in cr and the imaginary in ci
+    m_FFTSpec->cfft(ci, cr, m_FFT_Order, m_FFTBuf);
+#endif
+    dcopy(cr, bufL, m_blkSize);
+    dcopy(ci, bufR, m_blkSize);
+    if(scale != 1.0)
+    {
+        nspdbMpy1(scale, bufL, m_blkSize);
+        nspdbMpy1(scale, bufR, m_blkSize);
+    }
 #endif
 }
 
@@ -218,12 +457,138 @@ void ipp_fft::mulSpec(Float64 *src1, Float64 *src2, Float64 *dst)
     }
     dst[m_blkSize-1] = 0.0;
 #endif
-#else // MACOS
+#else // MACOS, LINUX
 	dmul3(src1, src2,            dst,            m_hblkSize);
 	dmul3(src1, src2+m_hblkSize, dst+m_hblkSize, m_hblkSize);
 #endif
 }
 
+// ------------------------------------------------------
+
+#if LINUX
+// split re/im, cell 0 holds Nyquist in its imaginary slot.
+// Float32 spectra are widened on the load.
+
+static inline TVecD vd_load_any(const Float64 *p)
+{ return vd_load(p); }
+
+static inline TVecD vd_load_any(const Float32 *p)
+{ return vd_loadf(p); }
+
+template<class T>
+static void split_power(const T *re, const T *im, const Float64 *wts,
+                        Float64 *dst, UInt32 ncells)
+{
+	UInt32 ix = 1;
+	Float64 r0 = re[0];
+	dst[0] = (r0*r0)*wts[0];
+	for(; ix + VD_LANES <= ncells; ix += VD_LANES)
+	{
+		TVecD vr = vd_load_any(re+ix);
+		TVecD vi = vd_load_any(im+ix);
+		TVecD p  = vd_add(vd_mul(vr, vr), vd_mul(vi, vi));
+		vd_store(dst+ix, vd_mul(p, vd_load(wts+ix)));
+	}
+	for(; ix < ncells; ++ix)
+	{
+		Float64 r = re[ix];
+		Float64 i = im[ix];
+		dst[ix] = (r*r + i*i)*wts[ix];
+	}
+}
+#endif
+
+// running sum in place, the DC cell counted half
+
+static Float64 prefix_sum_half_dc(Float64 *dst, UInt32 ncells)
+{
+	Float64 sum = 0.5*dst[0];
+	dst[0] = sum;
+	for(UInt32 ix = 1; ix < ncells; ++ix)
+	{
+		sum += dst[ix];
+		dst[ix] = sum;
+	}
+	return sum;
+}
+
+void ipp_fft::power_spectrum(const Float64 *ft, const Float64 *wts, Float64 *dst, UInt32 ncells)
+{
+#if WIN32
+	// packed R0,R1,I1,R2,I2,... -- cells from 1 up are interleaved complex
+	dst[0] = ft[0]*ft[0];
+	ippsPowerSpectr_64fc((const Ipp64fc*)(ft+1), dst+1, ncells-1);
+	ippsMul_64f_I(wts, dst, ncells);
+#elif MACOS
+	DSPDoubleSplitComplex cft = {(Float64*)ft+1, (Float64*)ft + m_hblkSize + 1};
+	dst[0] = ft[0]*ft[0];
+	vDSP_zvmagsD(&cft, 1, dst+1, 1, ncells-1);
+	vDSP_vmulD(dst, 1, wts, 1, dst, 1, ncells);
+#else // LINUX
+	split_power(ft, ft + m_hblkSize, wts, dst, ncells);
+#endif
+}
+
+void ipp_fft::power_spectrum(const Float32 *ft, const Float64 *wts, Float64 *dst, UInt32 ncells)
+{
+	// magnitudes in single precision where the platform does them,
+	// weights and sums in double. The single-precision magnitudes pass
+	// through a buffer on the stack, not our scratch buffers: several
+	// channels share this FFT and may be here at the same time.
+#if WIN32
+	Float32 pwr[64];
+	dst[0] = ft[0]*ft[0];
+	for(UInt32 ix = 1; ix < ncells; ix += 64)
+	{
+		UInt32 n = (ncells - ix < 64) ? ncells - ix : 64;
+		ippsPowerSpectr_32fc((const Ipp32fc*)(ft + 2*ix - 1), pwr, n);
+		ippsConvert_32f64f(pwr, dst + ix, n);
+	}
+	ippsMul_64f_I(wts, dst, ncells);
+#elif MACOS
+	Float32 pwr[64];
+	dst[0] = ft[0]*ft[0];
+	for(UInt32 ix = 1; ix < ncells; ix += 64)
+	{
+		UInt32 n = (ncells - ix < 64) ? ncells - ix : 64;
+		DSPSplitComplex cft = {(Float32*)ft + ix, (Float32*)ft + m_hblkSize + ix};
+		vDSP_zvmags(&cft, 1, pwr, 1, n);
+		vDSP_vspdp(pwr, 1, dst + ix, 1, n);
+	}
+	vDSP_vmulD(dst, 1, wts, 1, dst, 1, ncells);
+#else // LINUX
+	split_power(ft, ft + m_hblkSize, wts, dst, ncells);
+#endif
+}
+
+Float64 ipp_fft::power_prefix_sum(const Float64 *ft, const Float64 *wts, Float64 *dst, UInt32 ncells)
+{
+	// the scan itself is serial, the powers are not
+	power_spectrum(ft, wts, dst, ncells);
+	return prefix_sum_half_dc(dst, ncells);
+}
+
+Float64 ipp_fft::power_prefix_sum(const Float32 *ft, const Float64 *wts, Float64 *dst, UInt32 ncells)
+{
+	power_spectrum(ft, wts, dst, ncells);
+	return prefix_sum_half_dc(dst, ncells);
+}
+
+void ipp_fft::set_real_gains(Float64 *ft, const Float64 *gains, UInt32 ncells)
+{
+#if WIN32
+	ippsZero_64f(ft, m_blkSize);
+	ft[0] = gains[0];
+	for(UInt32 ix = 1; ix < ncells; ++ix)
+		ft[2*ix-1] = gains[ix];
+#else // MACOS, LINUX
+	// real parts up front, then the tail, Nyquist and the imaginary parts
+	// are one contiguous stretch
+	dcopy((Float64*)gains, ft, ncells);
+	dzero(ft + ncells, m_blkSize - ncells);
+#endif
+}
+
 #if MACOS
 void ippsMulPack_64f(Float64 *src1, Float64 *src2, Float64 *dst, UInt32 nel)
 {
@@ -78,6 +78,26 @@ extern void ippsMulPack_64f(Float64 *src1, Float64 *src2, Float64 *dst, UInt32 n
 
 #endif // MACOS
 
+// --------------------------------------
+#ifdef LINUX
+#include "simd_vec.h"
+#include "simd_fft.h"
+
+#define vectorAddD2(src,dst,nel)     vdadd(src,dst,dst,nel)
+#define copy_dtof(src,dst,nel)       vdtof(src,dst,nel)
+#define copy_ftod(src,dst,nel)       vftod(src,dst,nel)
+#define nspdbMpy3(src1,src2,dst,nel) vdmul(src1,src2,dst,nel)
+#define nspdbMpy2(src,srcdst,nel)    vdmul(src,srcdst,srcdst,nel)
+#define nspdbAdd2(src,srcdst,nel)    vdadd(src,srcdst,srcdst,nel)
+#define nspdbMpy1(k,srcdst,nel)      vdsmul(srcdst,k,srcdst,nel)
+
+typedef TPtr<Float64> DZPtr;
+
+#define DISABLE_DENORMALS
+#define RESTORE_DENORMALS
+
+#endif // LINUX
+
 // --------------------------------------
 #ifdef WIN32
 
@@ -172,7 +192,7 @@ public:
 // -----------------------------------------
 // -----------------------------------------
 
-#ifdef MACOS
+#if defined(MACOS) || defined(LINUX)
 #define IPP_FFT_DIV_FWD_BY_N   1
 #define IPP_FFT_DIV_INV_BY_N   2
 #define IPP_FFT_NODIV_BY_ANY   3
@@ -187,7 +207,39 @@ public:
 	void init(UInt32 fft_order, UInt32 flag = IPP_FFT_DIV_FWD_BY_N);
 	void fwd(Float64 *buf);
 	void inv(Float64 *buf);
+    
+    // forward transforms that read their input in place, so the caller
+    // can hand over a pointer into its own input history. fwd_windowed
+    // applies win on the way in. Only cells below ncells are wanted, our
+    // own FFT zeroes the rest.
+    void fwd(const Float64 *src, Float64 *dst);
+    void fwd_windowed(const Float64 *src, const Float64 *win, Float64 *dst, UInt32 ncells);
+    
+    // the same in single precision, for the power estimation path --
+    // a Float32 spectrum in the same layout as the Float64 ones
+    void fwd_windowed(const Float64 *src, const Float64 *win, Float32 *dst, UInt32 ncells);
+    
+    // two real transforms for the price of one complex transform,
+    // left riding in the real part, right in the imaginary part
+    void fwd2(Float64 *bufL, Float64 *bufR);
+    void inv2(Float64 *bufL, Float64 *bufR);
     void mulSpec(Float64 *src1, Float64 *src2, Float64 *dst);
+    
+    // bulk cell access, for the loops over the audible cells 0 <= k < ncells
+    // that otherwise go one get_FT_cell/set_FT_cell at a time
+    //
+    //   power_spectrum      dst[k] = |ft[k]|^2 * wts[k]
+    //   power_prefix_sum    dst[k] = sum of power_spectrum through cell k,
+    //                       with the DC cell counted half. Returns dst[ncells-1].
+    //   set_real_gains      ft = gains[k], real, below ncells, zero from
+    //                       ncells up, Nyquist included
+    // The power spectra touch no scratch buffers of ours, channels sharing
+    // one ipp_fft may take them concurrently.
+    void power_spectrum(const Float64 *ft, const Float64 *wts, Float64 *dst, UInt32 ncells);
+    void power_spectrum(const Float32 *ft, const Float64 *wts, Float64 *dst, UInt32 ncells);
+    Float64 power_prefix_sum(const Float64 *ft, const Float64 *wts, Float64 *dst, UInt32 ncells);
+    Float64 power_prefix_sum(const Float32 *ft, const Float64 *wts, Float64 *dst, UInt32 ncells);
+    void set_real_gains(Float64 *ft, const Float64 *gains, UInt32 ncells);
 
 protected:
 	virtual void init();
@@ -200,6 +252,9 @@ protected:
 #if WIN32
 	IppsFFTSpec_R_64f	*m_FFTSpec;
 	Ipp8u               *m_FFTBuf;
+	IppsFFTSpec_R_32f	*m_FFTSpecF;
+	Ipp8u               *m_FFTBufF;
+	Ipp32f              *m_WinBufF;
 
 public:
     // --------------------------------------------------------------
@@ -242,11 +297,23 @@ public:
     }
     // --------------------------------------------------------------
 
-#elif MACOS
+#elif MACOS || LINUX
+#if MACOS
     FFTSetupD            m_FFTSpec;
     Float64             *m_DataBuf;
+    FFTSetup             m_FFTSpecF;
+    Float32             *m_DataBufF;
+#else
+    TSimdFFT            *m_FFTSpec;
+    TSimdFFTF           *m_FFTSpecF;
+#endif
     Float64             *m_FFTBuf;
+    Float32             *m_FFTBufF;
+    Float64             *m_StageBuf;   // 2*m_blkSize for fwd2/inv2
     UInt32               m_hblkSize;
+    
+    void split_spectra(Float64 *re, Float64 *im, Float64 scale);
+    void join_spectra(Float64 *bufL, Float64 *bufR, Float64 *re, Float64 *im);
 
 public:
     // --------------------------------------------------------------
@@ -311,6 +378,10 @@ inline Float32 dotprodf(Float32 *src1, Float32 *src2, UInt32 nel)
 	ippsDotProd_32f(src1, src2, nel, &sum);
 #elif MACOS
 	vDSP_dotpr(src1, 1, src2, 1, &sum, nel);
+#else
+	sum = 0.0f;
+	for(UInt32 ix = 0; ix < nel; ++ix)
+		sum += src1[ix] * src2[ix];
 #endif
 	return sum;
 }
@@ -34,302 +34,241 @@
 #include <time.h>
 #endif
 #include <stdlib.h>
-//#include <dvec.h>
+#include <memory.h>
+#include <atomic>
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
 #include "my_types.h"
 #include "old-dither.h"
 
 #include "Version.h"
 
-#ifndef MACOS
-extern Float32 ran1(SInt32 *idum);
-static SInt32  seed = -1;
-#endif
-
-#define DITHER_TABLE_SIZE  0x20000	// 128K entries, must be pow(2)
-
-// -------------------------------------------------------------------------------------
-
-#if 0
-static const Float32 kDither_double_to_float = ldexpf(1.0f,-23);
-static const Float32 kDither_denorm          = ldexpf(1.0f,-34);
-#endif
+// values are made in blocks of this many on the stack
+#define DITHER_BLOCK_SIZE  64
 
 // -------------------------------------------------------------------------------------
+// Process seed and stream numbering. Both are atomics, so streams
+// may be created on any thread without a lock.
 
-TRootDither::TRootDither()
+static UInt32 initial_seed()
 {
-#ifndef MACOS
-    time((time_t*)&seed);
+#ifdef MACOS
+    return arc4random();
+#else
+    return (UInt32)time(0);
 #endif
-    
-    fill_dither_table();
 }
 
-TRootDither::~TRootDither()
+static std::atomic<UInt32> gProcessSeed(initial_seed());
+static std::atomic<UInt32> gNextStream(0);
+
+void TDither::set_process_seed(UInt32 seed)
 {
-    delete dither_table;
+    gProcessSeed = seed;
+    gNextStream  = 0;
 }
 
 // ----------------------------------------------------------------------
-// TPDF dither
+// Counter-based TPDF generator
+//
+// dither_hash() is a 32-bit integer finalizer with full avalanche.
+// Each sample hashes its own counter value, so a block of samples
+// can be made in parallel, and the upper and lower halves of the hash
+// give the two uniform variates whose difference is TPDF.
+// The result has range (-1.0, 1.0) ULP, the ULP being 2^-24.
 
-Float32 uniform_variate()
+static inline UInt32 dither_hash(UInt32 x)
 {
-    // return a uniform random variate in the range (0.0, 1.0)
-#ifdef MACOS
-    return ldexpf((Float32)arc4random(),-32);
-#else
-    return ran1(&seed);
-#endif
+    x ^= x >> 16;
+    x *= 0x7feb352dU;
+    x ^= x >> 15;
+    x *= 0x846ca68bU;
+    x ^= x >> 16;
+    return x;
 }
 
-Float32 tpdf_variate()
+static inline Float32 tpdf_from_hash(UInt32 h)
 {
-    // return a TPDF random variate in the range (-1.0, 1.0)
-    return (uniform_variate() - uniform_variate());
+    return ldexpf((Float32)((SInt32)(h >> 16) - (SInt32)(h & 0xffff)), -40);
 }
 
-void TRootDither::fill_dither_table()
+TDither::TDither()
 {
-    if(!dither_table)
-    {
-        dither_table_size = DITHER_TABLE_SIZE;
-        dither_table = new Float32[dither_table_size];
-        
-        // Flat spectral shaping
-        // the difference of two successive uniform random values
-        // produces a flat spectrum, but TPDF values
-        // resulting random TPDF has range (-1.0,1.0) ULP.
-        
-        for(UInt32 ix = 0; ix < dither_table_size; ++ix)
-            dither_table[ix] = ldexpf(tpdf_variate(), -24);
-        
-        dither_index = 0;
-    }
+    seed(gProcessSeed, gNextStream++);
 }
 
-TRootDither gDither;
+TDither::TDither(UInt32 /* nel */)
+{
+    // the stream is counter-based now, nothing is preallocated
+    seed(gProcessSeed, gNextStream++);
+}
 
-// ----------------------------------------------------------------------
-TDither::TDither(UInt32 nel)
+void TDither::seed(UInt32 seed, UInt32 stream)
 {
-    dither_table = gDither.get_dither_block(nel);
-    dither_index = 0;
-    dither_table_size = nel;
+    m_key     = dither_hash(seed ^ dither_hash(stream + 0x9e3779b9U));
+    m_counter = 0;
+    m_plain_relax = false;
 }
 
-// ----------------------------------------------------------------------
-// ----------------------------------------------------------------------
-// ----------------------------------------------------------------------
-// dither_block -- return the address of a block of dither values of length nsamp
-// result should be treated as read-only
+Float64 TDither::next_dither()
+{
+    return (Float64)tpdf_from_hash(dither_hash(m_key + m_counter++));
+}
 
-Float32* TDither::get_dither_block(UInt32 nsamp)
+void TDither::fill_dither_block(Float32 *pdith, UInt32 nel)
 {
-    UInt32 offset = dither_index;
-    dither_index += nsamp;
-    if(dither_index >= dither_table_size)
+    UInt32 ix = 0;
+    
+#if defined(__AVX2__)
+    const __m256i vm1  = _mm256_set1_epi32(0x7feb352d);
+    const __m256i vm2  = _mm256_set1_epi32((int)0x846ca68bU);
+    const __m256i vlo  = _mm256_set1_epi32(0xffff);
+    const __m256  vsf  = _mm256_set1_ps(ldexpf(1.0f, -40));
+    __m256i       vctr = _mm256_add_epi32(_mm256_set1_epi32(m_key + m_counter),
+                                          _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+    for(; ix + 8 <= nel; ix += 8)
     {
-        dither_index = nsamp;
-        offset = 0;
+        __m256i x = vctr;
+        x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 16));
+        x = _mm256_mullo_epi32(x, vm1);
+        x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 15));
+        x = _mm256_mullo_epi32(x, vm2);
+        x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 16));
+        __m256i d = _mm256_sub_epi32(_mm256_srli_epi32(x, 16), _mm256_and_si256(x, vlo));
+        _mm256_storeu_ps(pdith + ix, _mm256_mul_ps(_mm256_cvtepi32_ps(d), vsf));
+        vctr = _mm256_add_epi32(vctr, _mm256_set1_epi32(8));
     }
-    return (dither_table + offset);
+#endif
+    for(; ix < nel; ++ix)
+        pdith[ix] = tpdf_from_hash(dither_hash(m_key + m_counter + ix));
+    m_counter += nel;
 }
 
-// -------------------------------------------------------------------------------------
+// ------------------------------------------------
+// Block copies, DITHER_BLOCK_SIZE samples at a time
 
-Float64 TDither::next_dither()
+void TDither::relax_dither_block(Float64 *pdst, UInt32 nel, UInt32 stride)
 {
-    if(dither_table)
+    Float32 pdith[DITHER_BLOCK_SIZE];
+    
+    if(m_plain_relax)
     {
-        UInt32 ix = dither_index++;
-        if(dither_index >= dither_table_size)
-            dither_index = 0;
-        return (Float64)dither_table[ix];
+        for(UInt32 ix = 0; ix < nel; ++ix)
+            pdst[ix*stride] = 0.0;
+        return;
+    }
+    while(nel > 0)
+    {
+        UInt32 nb = (nel < DITHER_BLOCK_SIZE) ? nel : DITHER_BLOCK_SIZE;
+        fill_dither_block(pdith, nb);
+        for(UInt32 ix = 0; ix < nb; ++ix)
+            pdst[ix*stride] = (Float64)pdith[ix];
+        pdst += nb*stride;
+        nel  -= nb;
     }
-    else
-        return (Float64)ldexpf(tpdf_variate(), -24);
 }
 
-// -------------------------------------------------------------------------------------
-#if 0
-Float64 TDither::dither_dtos()
+void TDither::copy_stod_with_denorm_dither(Float32 *psrc, Float64 *pdst, UInt32 nel)
 {
-    return next_dither() * kDither_double_to_float;
+    Float32 pdith[DITHER_BLOCK_SIZE];
+    
+    while(nel > 0)
+    {
+        UInt32 nb = (nel < DITHER_BLOCK_SIZE) ? nel : DITHER_BLOCK_SIZE;
+        fill_dither_block(pdith, nb);
+        for(UInt32 ix = 0; ix < nb; ++ix)
+            pdst[ix] = (Float64)(psrc[ix] + pdith[ix]);
+        psrc += nb;
+        pdst += nb;
+        nel  -= nb;
+    }
 }
 
-// -------------------------------------------------------------------------------------
-
-Float64 TDither::denorm_dither()
+void TDither::copy_stos_with_denorm_dither(Float32 *psrc, Float32 *pdst, UInt32 nel)
 {
-    return next_dither() * kDither_denorm;
+    Float32 pdith[DITHER_BLOCK_SIZE];
+    
+    while(nel > 0)
+    {
+        UInt32 nb = (nel < DITHER_BLOCK_SIZE) ? nel : DITHER_BLOCK_SIZE;
+        fill_dither_block(pdith, nb);
+        for(UInt32 ix = 0; ix < nb; ++ix)
+            pdst[ix] = psrc[ix] + pdith[ix];
+        psrc += nb;
+        pdst += nb;
+        nel  -= nb;
+    }
 }
-#endif
-// ------------------------------------------------
-// Non-parallel versions
-//
 
-#if 0
-#define DITHER_DENORM(pdst,type,psrc,pdith,ix)  \
-((pdst)[(ix)] = (type)((psrc)[(ix)] + (pdith)[(ix)] * kDither_denorm))
-#else
-#define DITHER_DENORM(pdst,type,psrc,pdith,ix)  \
-((pdst)[(ix)] = (type)((psrc)[(ix)] + (pdith)[(ix)]))
-#endif
+// Narrowing to Float32 with dither, optionally on top of what is in pdst.
+// The sums are formed in Float64 exactly as cvt_dtos() would.
 
-void TDither::copy_stod_with_denorm_dither(Float32 *psrc, Float64 *pdst, UInt32 nel)
+static inline void narrow_with_dither(const Float64 *psrc, const Float32 *pdith,
+                                      Float32 *pdst, UInt32 nb, bool accum)
 {
-    if(dither_table)
+    UInt32 ix = 0;
+    
+#if defined(__AVX__)
+    if(accum)
     {
-        Float32 *pdith = get_dither_block(nel);
-        
-        if(1 & nel)
-        {
-            DITHER_DENORM(pdst, Float64, psrc, pdith, 0);
-            ++psrc;
-            ++pdst;
-            ++pdith;
-        }
-        if(2 & nel)
-        {
-            DITHER_DENORM(pdst, Float64, psrc, pdith, 0);
-            DITHER_DENORM(pdst, Float64, psrc, pdith, 1);
-            psrc  += 2;
-            pdst  += 2;
-            pdith += 2;
-        }
-        if(4 & nel)
+        for(; ix + 4 <= nb; ix += 4)
         {
-            DITHER_DENORM(pdst, Float64, psrc, pdith, 0);
-            DITHER_DENORM(pdst, Float64, psrc, pdith, 1);
-            DITHER_DENORM(pdst, Float64, psrc, pdith, 2);
-            DITHER_DENORM(pdst, Float64, psrc, pdith, 3);
-            psrc  += 4;
-            pdst  += 4;
-            pdith += 4;
+            __m256d v = _mm256_add_pd(_mm256_cvtps_pd(_mm_loadu_ps(pdst + ix)),
+                                      _mm256_loadu_pd(psrc + ix));
+            v = _mm256_add_pd(v, _mm256_cvtps_pd(_mm_loadu_ps(pdith + ix)));
+            _mm_storeu_ps(pdst + ix, _mm256_cvtpd_ps(v));
         }
-        nel >>= 3;
-        while(nel-- > 0)
+    }
+    else
+    {
+        for(; ix + 4 <= nb; ix += 4)
         {
-            DITHER_DENORM(pdst, Float64, psrc, pdith, 0);
-            DITHER_DENORM(pdst, Float64, psrc, pdith, 1);
-            DITHER_DENORM(pdst, Float64, psrc, pdith, 2);
-            DITHER_DENORM(pdst, Float64, psrc, pdith, 3);
-            DITHER_DENORM(pdst, Float64, psrc, pdith, 4);
-            DITHER_DENORM(pdst, Float64, psrc, pdith, 5);
-            DITHER_DENORM(pdst, Float64, psrc, pdith, 6);
-            DITHER_DENORM(pdst, Float64, psrc, pdith, 7);
-            psrc  += 8;
-            pdst  += 8;
-            pdith += 8;
+            __m256d v = _mm256_add_pd(_mm256_loadu_pd(psrc + ix),
+                                      _mm256_cvtps_pd(_mm_loadu_ps(pdith + ix)));
+            _mm_storeu_ps(pdst + ix, _mm256_cvtpd_ps(v));
         }
     }
+#endif
+    if(accum)
+    {
+        for(; ix < nb; ++ix)
+            pdst[ix] = (Float32)((pdst[ix] + psrc[ix]) + pdith[ix]);
+    }
+    else
+    {
+        for(; ix < nb; ++ix)
+            pdst[ix] = (Float32)(psrc[ix] + pdith[ix]);
+    }
 }
 
-void TDither::copy_stos_with_denorm_dither(Float32 *psrc, Float32 *pdst, UInt32 nel)
+void TDither::copy_dtos_with_dither(Float64 *psrc, Float32 *pdst, UInt32 nel)
 {
-    if(dither_table)
+    Float32 pdith[DITHER_BLOCK_SIZE];
+    
+    while(nel > 0)
     {
-        Float32 *pdith = get_dither_block(nel);
-        
-        if(1 & nel)
-        {
-            DITHER_DENORM(pdst, Float32, psrc, pdith, 0);
-            ++psrc;
-            ++pdst;
-            ++pdith;
-        }
-        if(2 & nel)
-        {
-            DITHER_DENORM(pdst, Float32, psrc, pdith, 0);
-            DITHER_DENORM(pdst, Float32, psrc, pdith, 1);
-            psrc  += 2;
-            pdst  += 2;
-            pdith += 2;
-        }
-        if(4 & nel)
-        {
-            DITHER_DENORM(pdst, Float32, psrc, pdith, 0);
-            DITHER_DENORM(pdst, Float32, psrc, pdith, 1);
-            DITHER_DENORM(pdst, Float32, psrc, pdith, 2);
-            DITHER_DENORM(pdst, Float32, psrc, pdith, 3);
-            psrc  += 4;
-            pdst  += 4;
-            pdith += 4;
-        }
-        nel >>= 3;
-        while(nel-- > 0)
-        {
-            DITHER_DENORM(pdst, Float32, psrc, pdith, 0);
-            DITHER_DENORM(pdst, Float32, psrc, pdith, 1);
-            DITHER_DENORM(pdst, Float32, psrc, pdith, 2);
-            DITHER_DENORM(pdst, Float32, psrc, pdith, 3);
-            DITHER_DENORM(pdst, Float32, psrc, pdith, 4);
-            DITHER_DENORM(pdst, Float32, psrc, pdith, 5);
-            DITHER_DENORM(pdst, Float32, psrc, pdith, 6);
-            DITHER_DENORM(pdst, Float32, psrc, pdith, 7);
-            psrc  += 8;
-            pdst  += 8;
-            pdith += 8;
-        }
+        UInt32 nb = (nel < DITHER_BLOCK_SIZE) ? nel : DITHER_BLOCK_SIZE;
+        fill_dither_block(pdith, nb);
+        narrow_with_dither(psrc, pdith, pdst, nb, false);
+        psrc += nb;
+        pdst += nb;
+        nel  -= nb;
     }
 }
 
-// -------------------------------------------------------------------------------------
-#if 0
-#define DITHER_DTOF(pdst,type,psrc,pdith,ix)  \
-((pdst)[(ix)] = (type)((psrc)[(ix)] + (pdith)[(ix)] * kDither_double_to_float))
-#else
-#define DITHER_DTOF(pdst,type,psrc,pdith,ix)  \
-((pdst)[(ix)] = (type)((psrc)[(ix)] + (pdith)[(ix)]))
-#endif
-
-void TDither::copy_dtos_with_dither(Float64 *psrc, Float32 *pdst, UInt32 nel)
+void TDither::accum_dtos_with_dither(Float64 *psrc, Float32 *pdst, UInt32 nel)
 {
-    if(dither_table)
+    Float32 pdith[DITHER_BLOCK_SIZE];
+    
+    while(nel > 0)
     {
-        Float32 *pdith = get_dither_block(nel);
-        
-        if(1 & nel)
-        {
-            DITHER_DTOF(pdst,Float32,psrc,pdith,0);
-            ++psrc;
-            ++pdst;
-            ++pdith;
-        }
-        if(2 & nel)
-        {
-            DITHER_DTOF(pdst,Float32,psrc,pdith,0);
-            DITHER_DTOF(pdst,Float32,psrc,pdith,1);
-            psrc  += 2;
-            pdst  += 2;
-            pdith += 2;
-        }
-        if(4 & nel)
-        {
-            DITHER_DTOF(pdst,Float32,psrc,pdith,0);
-            DITHER_DTOF(pdst,Float32,psrc,pdith,1);
-            DITHER_DTOF(pdst,Float32,psrc,pdith,2);
-            DITHER_DTOF(pdst,Float32,psrc,pdith,3);
-            psrc  += 4;
-            pdst  += 4;
-            pdith += 4;
-        }
-        nel >>= 3;
-        while(nel-- > 0)
-        {
-            DITHER_DTOF(pdst,Float32,psrc,pdith,0);
-            DITHER_DTOF(pdst,Float32,psrc,pdith,1);
-            DITHER_DTOF(pdst,Float32,psrc,pdith,2);
-            DITHER_DTOF(pdst,Float32,psrc,pdith,3);
-            DITHER_DTOF(pdst,Float32,psrc,pdith,4);
-            DITHER_DTOF(pdst,Float32,psrc,pdith,5);
-            DITHER_DTOF(pdst,Float32,psrc,pdith,6);
-            DITHER_DTOF(pdst,Float32,psrc,pdith,7);
-            psrc  += 8;
-            pdst  += 8;
-            pdith += 8;
-        }
+        UInt32 nb = (nel < DITHER_BLOCK_SIZE) ? nel : DITHER_BLOCK_SIZE;
+        fill_dither_block(pdith, nb);
+        narrow_with_dither(psrc, pdith, pdst, nb, true);
+        psrc += nb;
+        pdst += nb;
+        nel  -= nb;
     }
 }
 
@@ -35,20 +35,39 @@
 #include "my_types.h"
 
 //-------------------------------------------------------------------
+// TDither -- TPDF dither of +/- 1 ULP at unit full scale.
+//
+// Values are generated on the fly by hashing a sample counter with the
+// stream's key, so there is no table to share and no state beyond two
+// words per stream. Every TDither is a stream of its own, and any number
+// of them may run on separate threads. A stream is fully determined by
+// its seed, so runs can be made reproducible with seed() or
+// set_process_seed().
+
 class TDither
 {
 protected:
-	Float32 *dither_table;
-	UInt32   dither_index;
-	UInt32   dither_table_size;
+	UInt32   m_key;
+	UInt32   m_counter;
+	bool     m_plain_relax;
     
 	Float64  next_dither();
-	Float32 *get_dither_block(UInt32 nel);
+	void     fill_dither_block(Float32 *pdith, UInt32 nel);
     
 public:
-    TDither() {};
+    // a fresh stream from the process seed
+    TDither();
+    
+    // nel was the length of a slice of the old shared table, now unused
 	TDither(UInt32 nel);
     
+    // restart this stream from a known state
+    void seed(UInt32 seed, UInt32 stream = 0);
+    
+    // seed for the streams made from now on, numbered from 0 in order of
+    // construction. Without it, the process seed comes from the clock.
+    static void set_process_seed(UInt32 seed);
+    
 	Float64 dither_dtos()
     { return next_dither(); }
     
@@ -59,28 +78,31 @@ public:
 	void copy_stos_with_denorm_dither(Float32 *psrc, Float32 *pdst, UInt32 nel);
 	void copy_dtos_with_dither(Float64 *psrc, Float32 *pdst, UInt32 nel);
     
+    // pdst += psrc, with dither, for output mixed into the host's buffer
+	void accum_dtos_with_dither(Float64 *psrc, Float32 *pdst, UInt32 nel);
+    
+    // With plain relaxation, safe_relax() adds no dither and relies on
+    // flush-to-zero to keep accum out of the denormals. Only for code
+    // that runs under a DAZFZ guard.
+    void set_plain_relax(bool arg)
+    { m_plain_relax = arg; }
+    
     Float64 safe_relax(Float64 &accum, Float64 newval, Float64 tc)
     {
-        accum += tc * (newval + denorm_dither() - accum);
+        if(!m_plain_relax)
+            newval += denorm_dither();
+        accum += tc * (newval - accum);
         return accum;
     }
     
+    // dither for nel relaxations done in bulk, zeros with plain relaxation,
+    // stride apart in pdst
+    void relax_dither_block(Float64 *pdst, UInt32 nel, UInt32 stride = 1);
+    
     Float32 cvt_dtos(Float64 x)
     { return (Float32)(x + dither_dtos()); }
 };
 
-// -----------------------------------------------------
-class TRootDither : public TDither
-{
-	void fill_dither_table();
-    
-public:
-    TRootDither();
-    virtual ~TRootDither();
-};
-
-extern TRootDither gDither;
-
 // -----------------------------------------------------
 
 #endif // __DITHER_H__
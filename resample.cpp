@@ -0,0 +1,208 @@
+// resample.cpp -- polyphase rate conversion around the Crescendo core
+// DM/RAL  10/26
+// ------------------------------------------------------
+
+/* -----------------------------------------------------------------------------
+ Copyright (c) 2016 Refined Audiometrics Laboratory, LLC
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ 3. The names of the authors and contributors may not be used to endorse
+ or promote products derived from this software without specific prior
+ written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+ ------------------------------------------------------------------------------- */
+
+#include <math.h>
+#include <memory.h>
+#include <vector>
+
+#include "resample.h"
+#include "simd_vec.h"
+
+// ------------------------------------------------------
+// branch lengths are a whole number of vectors
+
+static inline Float32 dot(const Float32 *a, const Float32 *b, UInt32 nel)
+{
+	typedef TVec<Float32> V;
+	V::type acc0 = V::splat(0.0f);
+	V::type acc1 = V::splat(0.0f);
+	UInt32  ix = 0;
+	for(; ix + 2*V::lanes <= nel; ix += 2*V::lanes)
+	{
+		acc0 = V::add(acc0, V::mul(V::load(a+ix), V::load(b+ix)));
+		acc1 = V::add(acc1, V::mul(V::load(a+ix+V::lanes), V::load(b+ix+V::lanes)));
+	}
+	for(; ix < nel; ix += V::lanes)
+		acc0 = V::add(acc0, V::mul(V::load(a+ix), V::load(b+ix)));
+	
+	Float32 lanes[V::lanes];
+	V::store(lanes, V::add(acc0, acc1));
+	Float32 sum = 0.0f;
+	for(UInt32 jx = 0; jx < (UInt32)V::lanes; ++jx)
+		sum += lanes[jx];
+	return sum;
+}
+
+// modified Bessel function of the first kind, order 0
+static Float64 bessel_i0(Float64 x)
+{
+	Float64 sum  = 1.0;
+	Float64 term = 1.0;
+	Float64 hx   = 0.5 * x;
+	for(UInt32 k = 1; k < 50; ++k)
+	{
+		term *= (hx / k) * (hx / k);
+		sum  += term;
+		if(term < 1.0e-12 * sum)
+			break;
+	}
+	return sum;
+}
+
+// ------------------------------------------------------
+
+TResampler::TResampler(UInt32 factor, UInt32 chunk)
+{
+	m_factor = factor;
+	m_ntaps  = factor * RESAMPLE_TAPS;
+	m_chunk  = chunk;
+	
+	m_DecimTaps.alloc(m_ntaps);
+	m_InterpTaps.alloc(m_ntaps);
+	m_DecimHist.alloc(2*m_ntaps);
+	m_InterpHist.alloc(2*RESAMPLE_TAPS);
+	m_CoreIn.alloc(chunk/factor + 1);
+	m_CoreOut.alloc(chunk/factor + 2);
+	
+	design_filter();
+	reset();
+}
+
+TResampler::~TResampler()
+{}
+
+void TResampler::reset()
+{
+	memset(m_DecimHist(), 0, 2*m_ntaps*sizeof(Float32));
+	memset(m_InterpHist(), 0, 2*RESAMPLE_TAPS*sizeof(Float32));
+	m_DecimPos    = 0;
+	m_DecimPhase  = 0;
+	m_InterpPos   = 0;
+	m_InterpPhase = 0;
+	m_CoreCount   = 0;
+	
+	// the core sample for the first output is one we never had
+	m_CoreOut[0] = 0.0f;
+	m_Pending    = 1;
+}
+
+void TResampler::design_filter()
+{
+	// Kaiser windowed sinc, unit gain at DC
+	Float64 beta   = 0.1102 * (RESAMPLE_ATTEN - 8.7);
+	Float64 fc     = 0.5 * RESAMPLE_CUTOFF / m_factor;  // cycles per host sample
+	Float64 center = 0.5 * (m_ntaps - 1);
+	Float64 pi     = acos(-1.0);
+	Float64 i0beta = bessel_i0(beta);
+	
+	std::vector<Float64> h(m_ntaps);
+	Float64 sum = 0.0;
+	for(UInt32 ix = 0; ix < m_ntaps; ++ix)
+	{
+		Float64 t = ix - center;
+		Float64 r = t / center;
+		Float64 w = bessel_i0(beta * sqrt(1.0 - r*r)) / i0beta;
+		h[ix] = 2.0 * fc * w * sin(2.0 * pi * fc * t) / (2.0 * pi * fc * t);
+		sum  += h[ix];
+	}
+	
+	// the decimator's dot product runs over the history oldest first
+	for(UInt32 ix = 0; ix < m_ntaps; ++ix)
+		m_DecimTaps[ix] = (Float32)(h[m_ntaps - 1 - ix] / sum);
+	
+	// branch p of the interpolator takes taps p, p+M, p+2M, ...
+	// against the core history, also oldest first
+	for(UInt32 p = 0; p < m_factor; ++p)
+	{
+		Float32 *g = m_InterpTaps() + p*RESAMPLE_TAPS;
+		for(UInt32 ix = 0; ix < RESAMPLE_TAPS; ++ix)
+			g[ix] = (Float32)(m_factor * h[p + (RESAMPLE_TAPS - 1 - ix)*m_factor] / sum);
+	}
+}
+
+UInt32 TResampler::decimate(const Float32 *src, UInt32 nel)
+{
+	Float32 *hist = m_DecimHist();
+	Float32 *taps = m_DecimTaps();
+	Float32 *dst  = m_CoreIn();
+	UInt32   ncore = 0;
+	
+	for(UInt32 ix = 0; ix < nel; ++ix)
+	{
+		hist[m_DecimPos] = hist[m_DecimPos + m_ntaps] = src[ix];
+		if(++m_DecimPos == m_ntaps)
+			m_DecimPos = 0;
+		if(++m_DecimPhase == m_factor)
+		{
+			m_DecimPhase = 0;
+			dst[ncore++] = dot(hist + m_DecimPos, taps, m_ntaps);
+		}
+	}
+	m_CoreCount = ncore;
+	return ncore;
+}
+
+void TResampler::interpolate(Float32 *dst, UInt32 nel, bool replace)
+{
+	Float32 *hist  = m_InterpHist();
+	Float32 *core  = m_CoreOut();
+	UInt32   avail = m_Pending + m_CoreCount;
+	UInt32   used  = 0;
+	
+	for(UInt32 ix = 0; ix < nel; ++ix)
+	{
+		if(0 == m_InterpPhase)
+		{
+			hist[m_InterpPos] = hist[m_InterpPos + RESAMPLE_TAPS] = core[used++];
+			if(++m_InterpPos == RESAMPLE_TAPS)
+				m_InterpPos = 0;
+		}
+		Float32 v = dot(hist + m_InterpPos,
+		                m_InterpTaps() + m_InterpPhase*RESAMPLE_TAPS,
+		                RESAMPLE_TAPS);
+		if(replace)
+			dst[ix] = v;
+		else
+			dst[ix] += v;
+		if(++m_InterpPhase == m_factor)
+			m_InterpPhase = 0;
+	}
+	
+	// at most the one sample completed by the last input
+	m_Pending = avail - used;
+	for(UInt32 ix = 0; ix < m_Pending; ++ix)
+		core[ix] = core[used + ix];
+	m_CoreCount = 0;
+}
+
+// -- end of resample.cpp -- //
@@ -0,0 +1,115 @@
+// resample.h -- polyphase rate conversion around the Crescendo core
+// DM/RAL  10/26
+// -------------------------------------------------------------
+
+/* -----------------------------------------------------------------------------
+ Copyright (c) 2016 Refined Audiometrics Laboratory, LLC
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ 3. The names of the authors and contributors may not be used to endorse
+ or promote products derived from this software without specific prior
+ written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+ ------------------------------------------------------------------------------- */
+#ifndef __RESAMPLE_H__
+#define __RESAMPLE_H__
+
+#include "smart_ptr.h"
+
+// -------------------------------------------------------------
+// TResampler -- decimation of one channel's host rate input by an
+// integer factor M, and interpolation of the core's output back up.
+// Both run the same linear phase lowpass, M*RESAMPLE_TAPS long, cut
+// off just short of the core rate's Nyquist frequency. Only the
+// polyphase branch needed for each output sample is evaluated.
+//
+// The resampler holds the core's input and output for one pass of at
+// most get_chunk() host samples:
+//
+//   ncore = rs->decimate(pin, nel);         // into core_input()
+//   ... core renders ncore samples from core_input() to core_output()
+//   rs->interpolate(pout, nel, replace);    // from core_output()
+//
+// Core output sample k becomes available one host sample after the
+// input that completed it, and that one sample is carried between
+// passes. Together with the two filters the added delay is exactly
+// get_latency() host samples.
+
+#define RESAMPLE_TAPS     64      // per polyphase branch
+#define RESAMPLE_CUTOFF   0.92    // of the core rate's Nyquist frequency
+#define RESAMPLE_ATTEN    80.0    // dB stopband
+
+class TResampler
+{
+	UInt32         m_factor;
+	UInt32         m_ntaps;        // m_factor * RESAMPLE_TAPS
+	UInt32         m_chunk;
+	
+	TPtr<Float32>  m_DecimTaps;    // reversed
+	TPtr<Float32>  m_InterpTaps;   // by branch, reversed, gain m_factor
+	
+	// input and core histories, mirrored so the last n are contiguous
+	TPtr<Float32>  m_DecimHist;
+	UInt32         m_DecimPos;
+	UInt32         m_DecimPhase;
+	TPtr<Float32>  m_InterpHist;
+	UInt32         m_InterpPos;
+	UInt32         m_InterpPhase;
+	
+	TPtr<Float32>  m_CoreIn;
+	TPtr<Float32>  m_CoreOut;
+	UInt32         m_CoreCount;    // from the last decimate()
+	UInt32         m_Pending;      // core output not yet interpolated
+	
+	void design_filter();
+	
+public:
+	TResampler(UInt32 factor, UInt32 chunk);
+	virtual ~TResampler();
+	
+	void reset();
+	
+	UInt32 get_factor()
+	{ return m_factor; }
+	
+	// most host samples per pass
+	UInt32 get_chunk()
+	{ return m_chunk; }
+	
+	// host samples of delay, on top of the core's own
+	UInt32 get_latency()
+	{ return m_ntaps; }
+	
+	Float32* core_input()
+	{ return m_CoreIn(); }
+	
+	Float32* core_output()
+	{ return m_CoreOut() + m_Pending; }
+	
+	// nel <= get_chunk(), returns the number of core samples
+	UInt32 decimate(const Float32 *src, UInt32 nel);
+	void   interpolate(Float32 *dst, UInt32 nel, bool replace);
+};
+
+#endif // __RESAMPLE_H__
+
+// -- end of resample.h -- //
@@ -0,0 +1,363 @@
+// simd_fft.cpp -- Portable SIMD FFT for platforms without vDSP or IPP
+// DM/RAL  10/26
+// ------------------------------------------------------
+
+/* -----------------------------------------------------------------------------
+ Copyright (c) 2016 Refined Audiometrics Laboratory, LLC
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ 3. The names of the authors and contributors may not be used to endorse
+ or promote products derived from this software without specific prior
+ written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+ ------------------------------------------------------------------------------- */
+
+#include <math.h>
+#include <memory.h>
+#include <mutex>
+
+#include "simd_fft.h"
+#include "simd_vec.h"
+
+// ------------------------------------------------------
+// Twiddles for the largest transform, N = 2^order real points.
+// Complex transforms of size n <= N step through the same table
+// with a stride of N/n.
+
+template<class T>
+TSimdFFT_t<T>::TSimdFFT_t(UInt32 order)
+{
+	m_order = order;
+	m_nfft  = (1 << order);
+	m_refs  = 0;
+	m_next  = 0;
+
+	UInt32  nh  = m_nfft >> 1;
+	Float64 pif = 2.0 * acos(-1.0) / m_nfft;
+
+	m_twr = new T[nh];
+	m_twi = new T[nh];
+	for(UInt32 ix = 0; ix < nh; ++ix)
+	{
+		m_twr[ix] = (T) cos(pif * ix);
+		m_twi[ix] = (T)-sin(pif * ix);
+	}
+}
+
+template<class T>
+TSimdFFT_t<T>::~TSimdFFT_t()
+{
+	delete [] m_twr;
+	delete [] m_twi;
+}
+
+// ------------------------------------------------------
+// Setups are read-only once made, so every workspace of every
+// processor at a given order and precision shares one.
+
+static std::mutex gSetupsLock;
+
+template<class T>
+TSimdFFT_t<T> *TSimdFFT_t<T>::s_setups = 0;
+
+template<class T>
+TSimdFFT_t<T> *TSimdFFT_t<T>::acquire(UInt32 order)
+{
+	std::lock_guard<std::mutex> lock(gSetupsLock);
+
+	TSimdFFT_t *setup;
+	for(setup = s_setups; setup; setup = setup->m_next)
+	{
+		if(setup->m_order == order)
+			break;
+	}
+	if(0 == setup)
+	{
+		setup = new TSimdFFT_t(order);
+		setup->m_next = s_setups;
+		s_setups = setup;
+	}
+	++setup->m_refs;
+	return setup;
+}
+
+template<class T>
+void TSimdFFT_t<T>::release(TSimdFFT_t *setup)
+{
+	if(0 == setup)
+		return;
+
+	std::lock_guard<std::mutex> lock(gSetupsLock);
+
+	TSimdFFT_t **pp;
+	for(pp = &s_setups; *pp; pp = &(*pp)->m_next)
+	{
+		if(*pp == setup)
+		{
+			if(0 == --setup->m_refs)
+			{
+				*pp = setup->m_next;
+				delete setup;
+			}
+			return;
+		}
+	}
+}
+
+// ------------------------------------------------------
+// Radix-2 Stockham autosort, decimation in frequency.
+// Ping-pongs between (xr,xi) and (yr,yi), no bit reversal pass.
+// Inner loops run over contiguous stretches of length s, which
+// are vectorized once s reaches the register width.
+//
+// Returns true if the result landed in (yr,yi).
+
+template<class T>
+bool TSimdFFT_t<T>::stockham(T *xr, T *xi, T *yr, T *yi, UInt32 log2n)
+{
+	typedef TVec<T>           V;
+	typedef typename V::type  TV;
+
+	UInt32 n       = (1 << log2n);
+	UInt32 s       = 1;
+	UInt32 tstride = m_nfft / n;
+	bool   swapped = false;
+
+	for(; n > 1; n >>= 1, s <<= 1, tstride <<= 1)
+	{
+		UInt32 m = n >> 1;
+
+		if(s < V::lanes)
+		{
+			for(UInt32 p = 0; p < m; ++p)
+			{
+				T wr = m_twr[p*tstride];
+				T wi = m_twi[p*tstride];
+				T *ar = xr + s*p;
+				T *ai = xi + s*p;
+				T *br = ar + s*m;
+				T *bi = ai + s*m;
+				T *cr = yr + 2*s*p;
+				T *ci = yi + 2*s*p;
+				T *dr = cr + s;
+				T *di = ci + s;
+				for(UInt32 q = 0; q < s; ++q)
+				{
+					T tr = ar[q] - br[q];
+					T ti = ai[q] - bi[q];
+					cr[q] = ar[q] + br[q];
+					ci[q] = ai[q] + bi[q];
+					dr[q] = tr*wr - ti*wi;
+					di[q] = tr*wi + ti*wr;
+				}
+			}
+		}
+		else
+		{
+			for(UInt32 p = 0; p < m; ++p)
+			{
+				TV wr = V::splat(m_twr[p*tstride]);
+				TV wi = V::splat(m_twi[p*tstride]);
+				T *ar = xr + s*p;
+				T *ai = xi + s*p;
+				T *br = ar + s*m;
+				T *bi = ai + s*m;
+				T *cr = yr + 2*s*p;
+				T *ci = yi + 2*s*p;
+				T *dr = cr + s;
+				T *di = ci + s;
+				for(UInt32 q = 0; q < s; q += V::lanes)
+				{
+					TV var = V::load(ar+q);
+					TV vai = V::load(ai+q);
+					TV vbr = V::load(br+q);
+					TV vbi = V::load(bi+q);
+					TV tr  = V::sub(var, vbr);
+					TV ti  = V::sub(vai, vbi);
+					V::store(cr+q, V::add(var, vbr));
+					V::store(ci+q, V::add(vai, vbi));
+					V::store(dr+q, V::sub(V::mul(tr, wr), V::mul(ti, wi)));
+					V::store(di+q, V::add(V::mul(tr, wi), V::mul(ti, wr)));
+				}
+			}
+		}
+
+		T *tmp;
+		tmp = xr; xr = yr; yr = tmp;
+		tmp = xi; xi = yi; yi = tmp;
+		swapped = !swapped;
+	}
+	return swapped;
+}
+
+// ------------------------------------------------------
+
+template<class T>
+void TSimdFFT_t<T>::cfft(T *re, T *im, UInt32 log2n, T *scratch)
+{
+	UInt32 n = (1 << log2n);
+	if(stockham(re, im, scratch, scratch + n, log2n))
+	{
+		memcpy(re, scratch,     n*sizeof(T));
+		memcpy(im, scratch + n, n*sizeof(T));
+	}
+}
+
+// ------------------------------------------------------
+// Real transforms by way of a half-size complex transform:
+// even samples ride in the real part, odd samples in the imaginary.
+//
+//   Z[k] = E[k] + i O[k]
+//   X[k] = E[k] + W^k O[k],   W = exp(-2 pi i/N)
+
+template<class T>
+void TSimdFFT_t<T>::rfft(const T *src, T *dst, T scale, T *scratch)
+{
+	UInt32  nh = m_nfft >> 1;
+	T      *ar = scratch;
+	T      *ai = scratch + nh;
+
+	for(UInt32 ix = 0; ix < nh; ++ix)
+	{
+		ar[ix] = src[2*ix];
+		ai[ix] = src[2*ix+1];
+	}
+	rfft_split(scratch, dst, scale, nh);
+}
+
+template<class T>
+void TSimdFFT_t<T>::rfft_windowed(const Float64 *src, const Float64 *win, T *dst,
+                                  T scale, T *scratch, UInt32 ncells)
+{
+	UInt32  nh = m_nfft >> 1;
+	T      *ar = scratch;
+	T      *ai = scratch + nh;
+
+	for(UInt32 ix = 0; ix < nh; ++ix)
+	{
+		ar[ix] = (T)(win[2*ix]   * src[2*ix]);
+		ai[ix] = (T)(win[2*ix+1] * src[2*ix+1]);
+	}
+	rfft_split(scratch, dst, scale, ncells);
+}
+
+// even samples in scratch[0..N/2), odd samples in scratch[N/2..N)
+
+template<class T>
+void TSimdFFT_t<T>::rfft_split(T *scratch, T *dst, T scale, UInt32 ncells)
+{
+	UInt32  nh = m_nfft >> 1;
+	T      *ar = scratch;
+	T      *ai = scratch + nh;
+	T      *br = scratch + 2*nh;
+	T      *bi = scratch + 3*nh;
+
+	T *zr = ar;
+	T *zi = ai;
+	if(stockham(ar, ai, br, bi, m_order-1))
+	{
+		zr = br;
+		zi = bi;
+	}
+
+	if(ncells > nh)
+		ncells = nh;
+	
+	T hscale = 0.5 * scale;
+	for(UInt32 k = 1; k < ncells; ++k)
+	{
+		T er  = zr[k] + zr[nh-k];
+		T ei  = zi[k] - zi[nh-k];
+		T ori = zr[nh-k] - zr[k];   // 2*Im O
+		T orr = zi[k] + zi[nh-k];   // 2*Re O
+		T wr  = m_twr[k];
+		T wi  = m_twi[k];
+		dst[k]    = hscale * (er + wr*orr - wi*ori);
+		dst[nh+k] = hscale * (ei + wr*ori + wi*orr);
+	}
+	T z0r = zr[0];
+	T z0i = zi[0];
+	dst[0]  = scale * (z0r + z0i);
+	dst[nh] = scale * (z0r - z0i);
+	if(ncells < nh)
+	{
+		memset(dst + ncells,      0, (nh - ncells)*sizeof(T));
+		memset(dst + nh + ncells, 0, (nh - ncells)*sizeof(T));
+	}
+}
+
+// ------------------------------------------------------
+//   Z[k] = (X[k] + X*[N/2-k]) + i W^-k (X[k] - X*[N/2-k])
+//
+// then an inverse half-size complex transform, by way of the
+// swap identity  IDFT(Z) = swap(DFT(swap(Z))).
+
+template<class T>
+void TSimdFFT_t<T>::rifft(const T *src, T *dst, T scale, T *scratch)
+{
+	UInt32  nh = m_nfft >> 1;
+	T      *ar = scratch;
+	T      *ai = scratch + nh;
+	T      *br = scratch + 2*nh;
+	T      *bi = scratch + 3*nh;
+
+	ar[0] = src[0] + src[nh];
+	ai[0] = src[0] - src[nh];
+	for(UInt32 k = 1; k < nh; ++k)
+	{
+		T xr  = src[k];
+		T xi  = src[nh+k];
+		T yr  = src[nh-k];
+		T yi  = src[m_nfft-k];
+		T pr  = xr - yr;
+		T pi  = xi + yi;
+		T wr  = m_twr[k];
+		T wi  = m_twi[k];
+		T cr  = wr*pr + wi*pi;
+		T ci  = wr*pi - wi*pr;
+		ar[k] = xr + yr - ci;
+		ai[k] = xi - yi + cr;
+	}
+
+	// swapped roles: ai is fed as the real part
+	T *zr = ai;
+	T *zi = ar;
+	if(stockham(ai, ar, bi, br, m_order-1))
+	{
+		zr = bi;
+		zi = br;
+	}
+
+	// zr/zi hold the swapped result, so zi is the real part
+	for(UInt32 ix = 0; ix < nh; ++ix)
+	{
+		dst[2*ix]   = scale * zi[ix];
+		dst[2*ix+1] = scale * zr[ix];
+	}
+}
+
+// ------------------------------------------------------
+
+template class TSimdFFT_t<Float64>;
+template class TSimdFFT_t<Float32>;
+
+// -- end of simd_fft.cpp -- //
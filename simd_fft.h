@@ -0,0 +1,110 @@
+// simd_fft.h -- Portable SIMD FFT for platforms without vDSP or IPP
+// DM/RAL  10/26
+// -------------------------------------------------------------
+
+/* -----------------------------------------------------------------------------
+ Copyright (c) 2016 Refined Audiometrics Laboratory, LLC
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ 3. The names of the authors and contributors may not be used to endorse
+ or promote products derived from this software without specific prior
+ written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+ ------------------------------------------------------------------------------- */
+#ifndef __SIMD_FFT_H__
+#define __SIMD_FFT_H__
+
+#include "my_types.h"
+
+// -------------------------------------------------------------
+// TSimdFFT -- the read-only part of an FFT, in the spirit of
+// vDSP's FFTSetupD. Holds the twiddles for a real transform of
+// size N = 2^order. Scratch space is supplied by the caller, so
+// one setup may be shared by any number of workspaces.
+//
+// Real spectra are produced in the same split layout as the vDSP
+// backend of ipp_fft:
+//
+//   ft[0]       = Re X[0]     (DC)
+//   ft[k]       = Re X[k]     0 < k < N/2
+//   ft[N/2]     = Re X[N/2]   (Nyquist)
+//   ft[N/2+k]   = Im X[k]     0 < k < N/2
+//
+// Complex data are split: separate real and imaginary arrays.
+// Transforms are unnormalized, scaling is left to the caller.
+//
+// The sample type T is Float64 or Float32, see TVec<T>. TSimdFFT
+// is the double precision transform the engine runs on, TSimdFFTF
+// the single precision one for analysis.
+
+template<class T>
+class TSimdFFT_t
+{
+	UInt32   m_order;
+	UInt32   m_nfft;
+	T       *m_twr;   // cos(2 pi k/N),  0 <= k < N/2
+	T       *m_twi;   // -sin(2 pi k/N)
+
+	UInt32      m_refs;
+	TSimdFFT_t *m_next;
+	static TSimdFFT_t *s_setups;
+
+	bool stockham(T *xr, T *xi, T *yr, T *yi, UInt32 log2n);
+	void rfft_split(T *scratch, T *dst, T scale, UInt32 ncells);
+
+public:
+	TSimdFFT_t(UInt32 order);
+	virtual ~TSimdFFT_t();
+
+	// find or make the shared setup for this order, and take a
+	// reference to it. Not for the audio thread.
+	static TSimdFFT_t *acquire(UInt32 order);
+
+	// drop a reference, the last one out frees the setup
+	static void release(TSimdFFT_t *setup);
+
+	// number of T of scratch needed by any of the transforms
+	UInt32 scratch_size()
+	{ return 2*m_nfft; }
+
+	// forward complex DFT of size 2^log2n <= N, in place
+	void cfft(T *re, T *im, UInt32 log2n, T *scratch);
+
+	// real forward DFT of N samples, src and dst may coincide
+	void rfft(const T *src, T *dst, T scale, T *scratch);
+
+	// inverse of rfft, spectrum to N real samples, src and dst may coincide
+	void rifft(const T *src, T *dst, T scale, T *scratch);
+
+	// rfft of win * src, the product formed in double precision on the
+	// way in, so that src may be the engine's own input history. Forms
+	// only cells below ncells, plus DC and Nyquist, and zeroes the rest.
+	void rfft_windowed(const Float64 *src, const Float64 *win, T *dst,
+	                   T scale, T *scratch, UInt32 ncells);
+};
+
+typedef TSimdFFT_t<Float64> TSimdFFT;
+typedef TSimdFFT_t<Float32> TSimdFFTF;
+
+#endif // __SIMD_FFT_H__
+
+// -- end of simd_fft.h -- //
@@ -0,0 +1,418 @@
+// simd_vec.h -- thin portable wrappers over SSE2/AVX vector registers
+// DM/RAL  10/26
+// -------------------------------------------------------------
+
+/* -----------------------------------------------------------------------------
+ Copyright (c) 2016 Refined Audiometrics Laboratory, LLC
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ 3. The names of the authors and contributors may not be used to endorse
+ or promote products derived from this software without specific prior
+ written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+ ------------------------------------------------------------------------------- */
+#ifndef __SIMD_VEC_H__
+#define __SIMD_VEC_H__
+
+#include <math.h>
+#include "my_types.h"
+
+// adding this to a double of magnitude below 2^51 rounds it to the
+// nearest whole number, which then sits in the low mantissa bits
+#define VD_ROUND_MAGIC  6755399441055744.0   // 1.5 * 2^52
+
+// -------------------------------------------------------------
+// TVecD - the widest double precision vector register we were
+// compiled for. AVX gives 4 lanes, SSE2 gives 2, anything else
+// degrades to plain scalar code with the same calling conventions.
+// TVecF is its single precision counterpart.
+//
+// All loads and stores are unaligned. Our buffers come from
+// operator new and there is no measurable penalty on anything
+// newer than Nehalem.
+
+#if defined(__AVX__)
+#include <immintrin.h>
+
+#define VD_LANES  4
+typedef __m256d TVecD;
+
+inline TVecD vd_load(const Float64 *p)        { return _mm256_loadu_pd(p); }
+inline void  vd_store(Float64 *p, TVecD v)    { _mm256_storeu_pd(p, v); }
+inline TVecD vd_splat(Float64 x)              { return _mm256_set1_pd(x); }
+inline TVecD vd_add(TVecD a, TVecD b)         { return _mm256_add_pd(a, b); }
+inline TVecD vd_sub(TVecD a, TVecD b)         { return _mm256_sub_pd(a, b); }
+inline TVecD vd_mul(TVecD a, TVecD b)         { return _mm256_mul_pd(a, b); }
+inline TVecD vd_min(TVecD a, TVecD b)         { return _mm256_min_pd(a, b); }
+inline TVecD vd_max(TVecD a, TVecD b)         { return _mm256_max_pd(a, b); }
+inline TVecD vd_div(TVecD a, TVecD b)         { return _mm256_div_pd(a, b); }
+
+// widening load, 4 floats to 4 doubles
+inline TVecD vd_loadf(const Float32 *p)       { return _mm256_cvtps_pd(_mm_loadu_ps(p)); }
+
+#define VF_LANES  8
+typedef __m256 TVecF;
+
+inline TVecF vf_load(const Float32 *p)        { return _mm256_loadu_ps(p); }
+inline void  vf_store(Float32 *p, TVecF v)    { _mm256_storeu_ps(p, v); }
+inline TVecF vf_splat(Float32 x)              { return _mm256_set1_ps(x); }
+inline TVecF vf_add(TVecF a, TVecF b)         { return _mm256_add_ps(a, b); }
+inline TVecF vf_sub(TVecF a, TVecF b)         { return _mm256_sub_ps(a, b); }
+inline TVecF vf_mul(TVecF a, TVecF b)         { return _mm256_mul_ps(a, b); }
+
+// lane masks, all ones where true
+typedef __m256d TMaskD;
+
+inline TMaskD vd_gt(TVecD a, TVecD b)         { return _mm256_cmp_pd(a, b, _CMP_GT_OQ); }
+inline TMaskD vd_lt(TVecD a, TVecD b)         { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+inline TMaskD vd_le(TVecD a, TVecD b)         { return _mm256_cmp_pd(a, b, _CMP_LE_OQ); }
+inline TMaskD vm_and(TMaskD a, TMaskD b)      { return _mm256_and_pd(a, b); }
+inline TMaskD vm_or(TMaskD a, TMaskD b)       { return _mm256_or_pd(a, b); }
+inline TMaskD vm_andnot(TMaskD a, TMaskD b)   { return _mm256_andnot_pd(a, b); }  // ~a & b
+inline TVecD  vd_select(TMaskD m, TVecD a, TVecD b) { return _mm256_blendv_pd(b, a, m); }
+
+// lane c of rk <-> lane k of rc
+inline void vd_transpose(TVecD &r0, TVecD &r1, TVecD &r2, TVecD &r3)
+{
+    __m256d t0 = _mm256_unpacklo_pd(r0, r1);
+    __m256d t1 = _mm256_unpackhi_pd(r0, r1);
+    __m256d t2 = _mm256_unpacklo_pd(r2, r3);
+    __m256d t3 = _mm256_unpackhi_pd(r2, r3);
+    r0 = _mm256_permute2f128_pd(t0, t2, 0x20);
+    r1 = _mm256_permute2f128_pd(t1, t3, 0x20);
+    r2 = _mm256_permute2f128_pd(t0, t2, 0x31);
+    r3 = _mm256_permute2f128_pd(t1, t3, 0x31);
+}
+
+// Exponent handling, for the dB kernels in useful_math.h.
+//
+//   vd_split_exp(x, e)   returns m in [1,2) with x = m * 2^e, x positive and normal
+//   vd_pow2_magic(t)     2^n, where t = n + VD_ROUND_MAGIC and -1022 <= n <= 1023
+//
+// AVX alone has no 256 bit integer ops, so without AVX2 we go
+// through the two SSE2 halves.
+
+#if defined(__AVX2__)
+inline TVecD vd_split_exp(TVecD x, TVecD &e)
+{
+    __m256i b  = _mm256_castpd_si256(x);
+    __m256i eb = _mm256_or_si256(_mm256_srli_epi64(b, 52),
+                                 _mm256_set1_epi64x(0x4330000000000000LL));
+    e = _mm256_sub_pd(_mm256_castsi256_pd(eb), _mm256_set1_pd(4503599627370496.0 + 1023.0));
+    return _mm256_castsi256_pd(_mm256_or_si256(_mm256_and_si256(b, _mm256_set1_epi64x(0x000fffffffffffffLL)),
+                                               _mm256_set1_epi64x(0x3ff0000000000000LL)));
+}
+
+inline TVecD vd_pow2_magic(TVecD t)
+{
+    __m256i b = _mm256_add_epi64(_mm256_castpd_si256(t), _mm256_set1_epi64x(1023));
+    return _mm256_castsi256_pd(_mm256_slli_epi64(b, 52));
+}
+#else
+inline __m128d vd2_split_exp(__m128d x, __m128d &e)
+{
+    __m128i b  = _mm_castpd_si128(x);
+    __m128i eb = _mm_or_si128(_mm_srli_epi64(b, 52), _mm_set1_epi64x(0x4330000000000000LL));
+    e = _mm_sub_pd(_mm_castsi128_pd(eb), _mm_set1_pd(4503599627370496.0 + 1023.0));
+    return _mm_castsi128_pd(_mm_or_si128(_mm_and_si128(b, _mm_set1_epi64x(0x000fffffffffffffLL)),
+                                         _mm_set1_epi64x(0x3ff0000000000000LL)));
+}
+
+inline __m128d vd2_pow2_magic(__m128d t)
+{
+    __m128i b = _mm_add_epi64(_mm_castpd_si128(t), _mm_set1_epi64x(1023));
+    return _mm_castsi128_pd(_mm_slli_epi64(b, 52));
+}
+
+inline TVecD vd_split_exp(TVecD x, TVecD &e)
+{
+    __m128d elo, ehi;
+    __m128d mlo = vd2_split_exp(_mm256_castpd256_pd128(x), elo);
+    __m128d mhi = vd2_split_exp(_mm256_extractf128_pd(x, 1), ehi);
+    e = _mm256_insertf128_pd(_mm256_castpd128_pd256(elo), ehi, 1);
+    return _mm256_insertf128_pd(_mm256_castpd128_pd256(mlo), mhi, 1);
+}
+
+inline TVecD vd_pow2_magic(TVecD t)
+{
+    __m128d lo = vd2_pow2_magic(_mm256_castpd256_pd128(t));
+    __m128d hi = vd2_pow2_magic(_mm256_extractf128_pd(t, 1));
+    return _mm256_insertf128_pd(_mm256_castpd128_pd256(lo), hi, 1);
+}
+#endif
+
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+
+#define VD_LANES  2
+typedef __m128d TVecD;
+
+inline TVecD vd_load(const Float64 *p)        { return _mm_loadu_pd(p); }
+inline void  vd_store(Float64 *p, TVecD v)    { _mm_storeu_pd(p, v); }
+inline TVecD vd_splat(Float64 x)              { return _mm_set1_pd(x); }
+inline TVecD vd_add(TVecD a, TVecD b)         { return _mm_add_pd(a, b); }
+inline TVecD vd_sub(TVecD a, TVecD b)         { return _mm_sub_pd(a, b); }
+inline TVecD vd_mul(TVecD a, TVecD b)         { return _mm_mul_pd(a, b); }
+inline TVecD vd_min(TVecD a, TVecD b)         { return _mm_min_pd(a, b); }
+inline TVecD vd_max(TVecD a, TVecD b)         { return _mm_max_pd(a, b); }
+inline TVecD vd_div(TVecD a, TVecD b)         { return _mm_div_pd(a, b); }
+
+// widening load, 2 floats to 2 doubles, unaligned
+inline TVecD vd_loadf(const Float32 *p)
+{ return _mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64((const __m128i*)p))); }
+
+#define VF_LANES  4
+typedef __m128 TVecF;
+
+inline TVecF vf_load(const Float32 *p)        { return _mm_loadu_ps(p); }
+inline void  vf_store(Float32 *p, TVecF v)    { _mm_storeu_ps(p, v); }
+inline TVecF vf_splat(Float32 x)              { return _mm_set1_ps(x); }
+inline TVecF vf_add(TVecF a, TVecF b)         { return _mm_add_ps(a, b); }
+inline TVecF vf_sub(TVecF a, TVecF b)         { return _mm_sub_ps(a, b); }
+inline TVecF vf_mul(TVecF a, TVecF b)         { return _mm_mul_ps(a, b); }
+
+typedef __m128d TMaskD;
+
+inline TMaskD vd_gt(TVecD a, TVecD b)         { return _mm_cmpgt_pd(a, b); }
+inline TMaskD vd_lt(TVecD a, TVecD b)         { return _mm_cmplt_pd(a, b); }
+inline TMaskD vd_le(TVecD a, TVecD b)         { return _mm_cmple_pd(a, b); }
+inline TMaskD vm_and(TMaskD a, TMaskD b)      { return _mm_and_pd(a, b); }
+inline TMaskD vm_or(TMaskD a, TMaskD b)       { return _mm_or_pd(a, b); }
+inline TMaskD vm_andnot(TMaskD a, TMaskD b)   { return _mm_andnot_pd(a, b); }
+inline TVecD  vd_select(TMaskD m, TVecD a, TVecD b)
+{ return _mm_or_pd(_mm_and_pd(m, a), _mm_andnot_pd(m, b)); }
+
+inline void vd_transpose(TVecD &r0, TVecD &r1)
+{
+    __m128d t0 = _mm_unpacklo_pd(r0, r1);
+    r1 = _mm_unpackhi_pd(r0, r1);
+    r0 = t0;
+}
+
+inline TVecD vd_split_exp(TVecD x, TVecD &e)
+{
+    __m128i b  = _mm_castpd_si128(x);
+    __m128i eb = _mm_or_si128(_mm_srli_epi64(b, 52), _mm_set1_epi64x(0x4330000000000000LL));
+    e = _mm_sub_pd(_mm_castsi128_pd(eb), _mm_set1_pd(4503599627370496.0 + 1023.0));
+    return _mm_castsi128_pd(_mm_or_si128(_mm_and_si128(b, _mm_set1_epi64x(0x000fffffffffffffLL)),
+                                         _mm_set1_epi64x(0x3ff0000000000000LL)));
+}
+
+inline TVecD vd_pow2_magic(TVecD t)
+{
+    __m128i b = _mm_add_epi64(_mm_castpd_si128(t), _mm_set1_epi64x(1023));
+    return _mm_castsi128_pd(_mm_slli_epi64(b, 52));
+}
+
+#else
+
+#define VD_LANES  1
+typedef Float64 TVecD;
+
+inline TVecD vd_load(const Float64 *p)        { return *p; }
+inline void  vd_store(Float64 *p, TVecD v)    { *p = v; }
+inline TVecD vd_splat(Float64 x)              { return x; }
+inline TVecD vd_add(TVecD a, TVecD b)         { return a + b; }
+inline TVecD vd_sub(TVecD a, TVecD b)         { return a - b; }
+inline TVecD vd_mul(TVecD a, TVecD b)         { return a * b; }
+inline TVecD vd_min(TVecD a, TVecD b)         { return (a <= b) ? a : b; }
+inline TVecD vd_max(TVecD a, TVecD b)         { return (a >= b) ? a : b; }
+inline TVecD vd_div(TVecD a, TVecD b)         { return a / b; }
+
+inline TVecD vd_loadf(const Float32 *p)       { return (Float64)*p; }
+
+#define VF_LANES  1
+typedef Float32 TVecF;
+
+inline TVecF vf_load(const Float32 *p)        { return *p; }
+inline void  vf_store(Float32 *p, TVecF v)    { *p = v; }
+inline TVecF vf_splat(Float32 x)              { return x; }
+inline TVecF vf_add(TVecF a, TVecF b)         { return a + b; }
+inline TVecF vf_sub(TVecF a, TVecF b)         { return a - b; }
+inline TVecF vf_mul(TVecF a, TVecF b)         { return a * b; }
+
+typedef bool TMaskD;
+
+inline TMaskD vd_gt(TVecD a, TVecD b)         { return (a > b); }
+inline TMaskD vd_lt(TVecD a, TVecD b)         { return (a < b); }
+inline TMaskD vd_le(TVecD a, TVecD b)         { return (a <= b); }
+inline TMaskD vm_and(TMaskD a, TMaskD b)      { return (a && b); }
+inline TMaskD vm_or(TMaskD a, TMaskD b)       { return (a || b); }
+inline TMaskD vm_andnot(TMaskD a, TMaskD b)   { return (!a && b); }
+inline TVecD  vd_select(TMaskD m, TVecD a, TVecD b) { return (m ? a : b); }
+
+inline TVecD vd_split_exp(TVecD x, TVecD &e)
+{
+    int ie;
+    Float64 m = frexp(x, &ie);
+    e = (Float64)(ie - 1);
+    return 2.0 * m;
+}
+
+inline TVecD vd_pow2_magic(TVecD t)
+{ return ldexp(1.0, (int)(t - VD_ROUND_MAGIC)); }
+
+#endif
+
+// -------------------------------------------------------------
+// TVec<T> - the same arithmetic by sample type, for code templated
+// on Float32 or Float64. TVecF has twice the lanes of TVecD.
+
+template<class T> struct TVec;
+
+template<> struct TVec<Float64>
+{
+    typedef TVecD type;
+    enum { lanes = VD_LANES };
+    static type load(const Float64 *p)        { return vd_load(p); }
+    static void store(Float64 *p, type v)     { vd_store(p, v); }
+    static type splat(Float64 x)              { return vd_splat(x); }
+    static type add(type a, type b)           { return vd_add(a, b); }
+    static type sub(type a, type b)           { return vd_sub(a, b); }
+    static type mul(type a, type b)           { return vd_mul(a, b); }
+};
+
+template<> struct TVec<Float32>
+{
+    typedef TVecF type;
+    enum { lanes = VF_LANES };
+    static type load(const Float32 *p)        { return vf_load(p); }
+    static void store(Float32 *p, type v)     { vf_store(p, v); }
+    static type splat(Float32 x)              { return vf_splat(x); }
+    static type add(type a, type b)           { return vf_add(a, b); }
+    static type sub(type a, type b)           { return vf_sub(a, b); }
+    static type mul(type a, type b)           { return vf_mul(a, b); }
+};
+
+// -------------------------------------------------------------
+// VD_LANES arrays side by side, row ix of array c at
+// dst[ix*VD_LANES + c], and back. On the way out a null array
+// drops its lane.
+
+inline void vd_interleave(const Float64 *const *src, Float64 *dst, UInt32 nrows)
+{
+    UInt32 ix = 0;
+#if VD_LANES == 4
+    const Float64 *s0 = src[0], *s1 = src[1], *s2 = src[2], *s3 = src[3];
+    for(; ix + 4 <= nrows; ix += 4)
+    {
+        TVecD r0 = vd_load(s0 + ix), r1 = vd_load(s1 + ix);
+        TVecD r2 = vd_load(s2 + ix), r3 = vd_load(s3 + ix);
+        vd_transpose(r0, r1, r2, r3);
+        vd_store(dst + 4*ix,      r0);
+        vd_store(dst + 4*ix + 4,  r1);
+        vd_store(dst + 4*ix + 8,  r2);
+        vd_store(dst + 4*ix + 12, r3);
+    }
+#elif VD_LANES == 2
+    const Float64 *s0 = src[0], *s1 = src[1];
+    for(; ix + 2 <= nrows; ix += 2)
+    {
+        TVecD r0 = vd_load(s0 + ix), r1 = vd_load(s1 + ix);
+        vd_transpose(r0, r1);
+        vd_store(dst + 2*ix,     r0);
+        vd_store(dst + 2*ix + 2, r1);
+    }
+#endif
+    for(; ix < nrows; ++ix)
+        for(UInt32 c = 0; c < VD_LANES; ++c)
+            dst[ix*VD_LANES + c] = src[c][ix];
+}
+
+inline void vd_deinterleave(const Float64 *src, Float64 *const *dst, UInt32 nrows)
+{
+    UInt32 ix = 0;
+#if VD_LANES == 4
+    Float64 *d0 = dst[0], *d1 = dst[1], *d2 = dst[2], *d3 = dst[3];
+    for(; ix + 4 <= nrows; ix += 4)
+    {
+        TVecD r0 = vd_load(src + 4*ix),     r1 = vd_load(src + 4*ix + 4);
+        TVecD r2 = vd_load(src + 4*ix + 8), r3 = vd_load(src + 4*ix + 12);
+        vd_transpose(r0, r1, r2, r3);
+        if(d0) vd_store(d0 + ix, r0);
+        if(d1) vd_store(d1 + ix, r1);
+        if(d2) vd_store(d2 + ix, r2);
+        if(d3) vd_store(d3 + ix, r3);
+    }
+#elif VD_LANES == 2
+    Float64 *d0 = dst[0], *d1 = dst[1];
+    for(; ix + 2 <= nrows; ix += 2)
+    {
+        TVecD r0 = vd_load(src + 2*ix), r1 = vd_load(src + 2*ix + 2);
+        vd_transpose(r0, r1);
+        if(d0) vd_store(d0 + ix, r0);
+        if(d1) vd_store(d1 + ix, r1);
+    }
+#endif
+    for(; ix < nrows; ++ix)
+        for(UInt32 c = 0; c < VD_LANES; ++c)
+            if(dst[c])
+                dst[c][ix] = src[ix*VD_LANES + c];
+}
+
+// -------------------------------------------------------------
+// Block kernels -- the handful of vDSP/IPP vector primitives
+// the engine relies on, for platforms that have neither.
+
+inline void vdadd(const Float64 *src1, const Float64 *src2, Float64 *dst, UInt32 nel)
+{
+    UInt32 ix = 0;
+    for(; ix + VD_LANES <= nel; ix += VD_LANES)
+        vd_store(dst+ix, vd_add(vd_load(src1+ix), vd_load(src2+ix)));
+    for(; ix < nel; ++ix)
+        dst[ix] = src1[ix] + src2[ix];
+}
+
+inline void vdmul(const Float64 *src1, const Float64 *src2, Float64 *dst, UInt32 nel)
+{
+    UInt32 ix = 0;
+    for(; ix + VD_LANES <= nel; ix += VD_LANES)
+        vd_store(dst+ix, vd_mul(vd_load(src1+ix), vd_load(src2+ix)));
+    for(; ix < nel; ++ix)
+        dst[ix] = src1[ix] * src2[ix];
+}
+
+inline void vdsmul(const Float64 *src, Float64 k, Float64 *dst, UInt32 nel)
+{
+    TVecD  vk = vd_splat(k);
+    UInt32 ix = 0;
+    for(; ix + VD_LANES <= nel; ix += VD_LANES)
+        vd_store(dst+ix, vd_mul(vd_load(src+ix), vk));
+    for(; ix < nel; ++ix)
+        dst[ix] = src[ix] * k;
+}
+
+inline void vdtof(const Float64 *src, Float32 *dst, UInt32 nel)
+{
+    for(UInt32 ix = 0; ix < nel; ++ix)
+        dst[ix] = (Float32)src[ix];
+}
+
+inline void vftod(const Float32 *src, Float64 *dst, UInt32 nel)
+{
+    for(UInt32 ix = 0; ix < nel; ++ix)
+        dst[ix] = (Float64)src[ix];
+}
+
+#endif // __SIMD_VEC_H__
+
+// -- end of simd_vec.h -- //
@@ -0,0 +1,152 @@
+// tbatch.cpp -- many processor calls in one, spread over a few threads
+// DM/RAL  10/26
+// ------------------------------------------------------
+
+/* -----------------------------------------------------------------------------
+ Copyright (c) 2016 Refined Audiometrics Laboratory, LLC
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ 3. The names of the authors and contributors may not be used to endorse
+ or promote products derived from this software without specific prior
+ written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+ ------------------------------------------------------------------------------- */
+
+#include <algorithm>
+#include <functional>
+#include <thread>
+
+#include "tbatch.h"
+#include "tworker.h"
+#include "crescendo.h"
+
+// ------------------------------------------------------
+
+TCrescendoBatch::TCrescendoBatch(UInt32 nthreads)
+{
+    if(0 == nthreads)
+        nthreads = std::thread::hardware_concurrency();
+    m_nworkers = max(nthreads, UInt32(1)) - 1;
+    m_workers  = new TWorker*[m_nworkers + 1];
+    for(UInt32 ix = 0; ix < m_nworkers; ++ix)
+        m_workers[ix] = new TWorker();
+    
+    m_order    = 0;
+    m_runs     = 0;
+    m_capacity = 0;
+    m_items    = 0;
+    m_stride   = 0;
+    m_nruns    = 0;
+    m_next.store(0);
+}
+
+TCrescendoBatch::~TCrescendoBatch()
+{
+    for(UInt32 ix = 0; ix < m_nworkers; ++ix)
+        delete m_workers[ix];
+    delete[] m_workers;
+    delete[] m_order;
+    delete[] m_runs;
+}
+
+// ------------------------------------------------------
+
+// instance first, then position in the batch
+struct TByInstance
+{
+    const UInt8 *items;
+    UInt32       stride;
+    
+    bool operator()(UInt32 a, UInt32 b) const
+    {
+        // std::less, the built-in < does not order unrelated pointers
+        const void *pa = ((const tCrescendoBatchItem*)(items + a*stride))->instance;
+        const void *pb = ((const tCrescendoBatchItem*)(items + b*stride))->instance;
+        return std::less<const void*>()(pa, pb) || (pa == pb && a < b);
+    }
+};
+
+SInt32 TCrescendoBatch::process(const tCrescendoBatchItem *items, UInt32 nitems, UInt32 item_size)
+{
+    // an earlier client's items may be shorter than ours, but there
+    // is no earlier revision yet
+    if(item_size < sizeof(tCrescendoBatchItem))
+        return -1;
+    if(0 == nitems)
+        return 0;
+    
+    if(nitems > m_capacity)
+    {
+        delete[] m_order;
+        delete[] m_runs;
+        m_capacity = nitems;
+        m_order = new UInt32[m_capacity];
+        m_runs  = new UInt32[m_capacity + 1];
+    }
+    m_items  = (const UInt8*)items;
+    m_stride = item_size;
+    
+    for(UInt32 ix = 0; ix < nitems; ++ix)
+        m_order[ix] = ix;
+    TByInstance by_instance = { m_items, m_stride };
+    std::sort(m_order, m_order + nitems, by_instance);
+    
+    m_nruns = 0;
+    for(UInt32 ix = 0; ix < nitems; ++ix)
+        if(0 == ix || item(m_order[ix])->instance != item(m_order[ix-1])->instance)
+            m_runs[m_nruns++] = ix;
+    m_runs[m_nruns] = nitems;
+    
+    // as many workers as there are groups beyond our own
+    UInt32 nwork = min(m_nworkers, m_nruns - 1);
+    m_next.store(0, std::memory_order_relaxed);
+    for(UInt32 ix = 0; ix < nwork; ++ix)
+        m_workers[ix]->post(worker_job, this);
+    run_groups();
+    for(UInt32 ix = 0; ix < nwork; ++ix)
+        m_workers[ix]->wait();
+    return nitems;
+}
+
+void TCrescendoBatch::worker_job(void *arg)
+{
+    ((TCrescendoBatch*)arg)->run_groups();
+}
+
+void TCrescendoBatch::run_groups()
+{
+    // take groups until there are none left
+    for(;;)
+    {
+        UInt32 grp = m_next.fetch_add(1, std::memory_order_relaxed);
+        if(grp >= m_nruns)
+            break;
+        for(UInt32 ix = m_runs[grp]; ix < m_runs[grp+1]; ++ix)
+        {
+            const tCrescendoBatchItem *it = item(m_order[ix]);
+            ((TCrescendo*)it->instance)->render(it->pinL, it->pinR, it->poutL, it->poutR,
+                                                it->nel, (0 != it->replace), it->parms);
+        }
+    }
+}
+
+// -- end of tbatch.cpp -- //
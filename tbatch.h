@@ -0,0 +1,84 @@
+// tbatch.h -- many processor calls in one, spread over a few threads
+// DM/RAL  10/26
+// -------------------------------------------------------------
+
+/* -----------------------------------------------------------------------------
+ Copyright (c) 2016 Refined Audiometrics Laboratory, LLC
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ 3. The names of the authors and contributors may not be used to endorse
+ or promote products derived from this software without specific prior
+ written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+ ------------------------------------------------------------------------------- */
+#ifndef __TBATCH_H__
+#define __TBATCH_H__
+
+#include <atomic>
+#include "my_types.h"
+#include "crescendo_dsp.h"
+
+class TWorker;
+
+// -------------------------------------------------------------
+// TCrescendoBatch -- runs a batch of tCrescendoBatchItem on the
+// calling thread and a team of TWorkers.
+//
+// The items are grouped by instance. Items for the same instance run
+// in array order, on one thread; groups run in any order and in
+// parallel. The grouping scratch grows to the largest batch seen,
+// so run a batch of the full size once before going real time.
+// The batch in progress lives in the object, one process() at a time.
+
+class TCrescendoBatch
+{
+    TWorker   **m_workers;
+    UInt32      m_nworkers;
+    
+    UInt32     *m_order;      // item indices, grouped by instance
+    UInt32     *m_runs;       // where each group starts in m_order
+    UInt32      m_capacity;
+    
+    // the batch in progress
+    const UInt8 *m_items;
+    UInt32       m_stride;
+    UInt32       m_nruns;
+    std::atomic<UInt32> m_next;
+    
+    const tCrescendoBatchItem *item(UInt32 ix)
+    { return (const tCrescendoBatchItem*)(m_items + ix*m_stride); }
+    
+    void run_groups();
+    static void worker_job(void *arg);
+    
+public:
+    // nthreads 0 for one per core, the caller's thread included
+    TCrescendoBatch(UInt32 nthreads = 0);
+    virtual ~TCrescendoBatch();
+    
+    // returns nitems, or -1 for an item size this revision cannot read
+    SInt32 process(const tCrescendoBatchItem *items, UInt32 nitems, UInt32 item_size);
+};
+
+#endif // __TBATCH_H__
+
+// -- end of tbatch.h -- //
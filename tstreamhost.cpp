@@ -0,0 +1,456 @@
+// tstreamhost.cpp -- many Crescendo streams on a work-stealing thread pool
+// DM/RAL  10/26
+// ------------------------------------------------------
+
+/* -----------------------------------------------------------------------------
+ Copyright (c) 2016 Refined Audiometrics Laboratory, LLC
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ 3. The names of the authors and contributors may not be used to endorse
+ or promote products derived from this software without specific prior
+ written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+ ------------------------------------------------------------------------------- */
+
+#include <chrono>
+#include <memory.h>
+
+#include "tstreamhost.h"
+#include "crescendo.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_IX86)
+#include <emmintrin.h>
+#define cpu_relax()   _mm_pause()
+#else
+#define cpu_relax()
+#endif
+
+// as in tworker.cpp
+#define SPIN_COUNT    1024
+#define YIELD_COUNT   4096
+#define NAP_USEC      50
+
+static UInt64 now_nsec()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// ------------------------------------------------------
+// One stream. The ring slots serve for input and then output: the
+// client pushes into slot pushed, a worker renders slot done, the
+// client pulls from slot pulled, all counted modulo the ring size.
+
+struct TStreamHost::TStream
+{
+    TCrescendo  *proc;
+    Float64      sampleRate;
+    UInt32       hop;
+    
+    Float32     *inbuf;    // [slot][L,R][hop]
+    Float32     *outbuf;
+    UInt64       arrival[STREAMHOST_QUEUE_HOPS];
+    bool         stereo[STREAMHOST_QUEUE_HOPS];
+    UInt32       channels;   // 0 until the first push, then 1 or 2
+    
+    std::atomic<UInt32> pushed;
+    std::atomic<UInt32> done;
+    std::atomic<UInt32> pulled;
+    
+    // true while on a queue or held by a worker, and the worker
+    // that held it last
+    std::atomic<bool>   scheduled;
+    std::atomic<UInt32> home;
+    
+    // set_params() hands over through here, the worker keeps its copy
+    std::mutex          parmsLock;
+    std::atomic<bool>   parmsDirty;
+    tVTuningParams      parms;
+    tVTuningParams      active;
+    bool                haveParms;
+    
+    std::atomic<UInt64> hops;
+    std::atomic<UInt64> samples;
+    std::atomic<UInt64> misses;
+    std::atomic<UInt64> overruns;
+    std::atomic<UInt64> busy;          // nsec
+    std::atomic<UInt64> maxLatency;    // nsec
+    
+    Float32 *slot_in(UInt32 seq, UInt32 chan)
+    { return inbuf + ((seq % STREAMHOST_QUEUE_HOPS)*2 + chan)*hop; }
+    
+    Float32 *slot_out(UInt32 seq, UInt32 chan)
+    { return outbuf + ((seq % STREAMHOST_QUEUE_HOPS)*2 + chan)*hop; }
+};
+
+// ------------------------------------------------------
+// A worker's queue of streams. Every stream is on at most one queue,
+// so a ring of m_nstreams entries never overflows. The owner takes
+// from the front, thieves from the back.
+
+struct TStreamHost::TWorkQueue
+{
+    std::mutex  lock;
+    TStream   **ring;
+    UInt32      size;
+    UInt32      head;
+    UInt32      count;
+    
+    void put(TStream *s)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        ring[(head + count) % size] = s;
+        ++count;
+    }
+    
+    TStream *take_front()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if(0 == count)
+            return 0;
+        TStream *s = ring[head];
+        head = (head + 1) % size;
+        --count;
+        return s;
+    }
+    
+    TStream *take_back()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if(0 == count)
+            return 0;
+        --count;
+        return ring[(head + count) % size];
+    }
+};
+
+// ------------------------------------------------------
+
+TStreamHost::TStreamHost(UInt32 nstreams, Float64 sampleRate, UInt32 nthreads)
+{
+    if(0 == nthreads)
+        nthreads = std::thread::hardware_concurrency();
+    m_nthreads = max(nthreads, UInt32(1));
+    m_nstreams = max(nstreams, UInt32(1));
+    
+    m_streams = new TStream[m_nstreams];
+    for(UInt32 ix = 0; ix < m_nstreams; ++ix)
+    {
+        TStream *s = &m_streams[ix];
+        s->proc       = new TCrescendo(sampleRate);
+        s->sampleRate = sampleRate;
+        s->hop        = 0;
+        s->inbuf      = 0;
+        s->outbuf     = 0;
+        s->channels   = 0;
+        s->haveParms  = false;
+        s->home.store(ix % m_nthreads);
+        s->pushed.store(0);
+        s->done.store(0);
+        s->pulled.store(0);
+        s->scheduled.store(false);
+        s->parmsDirty.store(false);
+    }
+    
+    m_queues = new TWorkQueue[m_nthreads];
+    for(UInt32 ix = 0; ix < m_nthreads; ++ix)
+    {
+        m_queues[ix].ring  = new TStream*[m_nstreams];
+        m_queues[ix].size  = m_nstreams;
+        m_queues[ix].head  = 0;
+        m_queues[ix].count = 0;
+    }
+    
+    m_threads = new std::thread*[m_nthreads];
+    for(UInt32 ix = 0; ix < m_nthreads; ++ix)
+        m_threads[ix] = 0;
+    m_startTime    = 0;
+    m_stopTime     = 0;
+    m_DeadlineHops = 1.0;
+    m_quit.store(false);
+    m_running.store(false);
+}
+
+TStreamHost::~TStreamHost()
+{
+    stop();
+    for(UInt32 ix = 0; ix < m_nthreads; ++ix)
+        delete[] m_queues[ix].ring;
+    delete[] m_queues;
+    delete[] m_threads;
+    for(UInt32 ix = 0; ix < m_nstreams; ++ix)
+    {
+        delete m_streams[ix].proc;
+        delete[] m_streams[ix].inbuf;
+        delete[] m_streams[ix].outbuf;
+    }
+    delete[] m_streams;
+}
+
+TCrescendo* TStreamHost::get_processor(UInt32 ix)
+{
+    return m_streams[ix].proc;
+}
+
+UInt32 TStreamHost::get_hop(UInt32 ix)
+{
+    return m_streams[ix].hop;
+}
+
+void TStreamHost::start()
+{
+    // size the rings for each processor's hop, as configured, and
+    // clear out anything left from before
+    if(m_running.load(std::memory_order_acquire))
+        return;
+    for(UInt32 ix = 0; ix < m_nstreams; ++ix)
+    {
+        TStream *s = &m_streams[ix];
+        UInt32 hop = s->proc->get_hblksize() * s->proc->get_RateFactor();
+        if(hop != s->hop)
+        {
+            delete[] s->inbuf;
+            delete[] s->outbuf;
+            s->hop    = hop;
+            s->inbuf  = new Float32[STREAMHOST_QUEUE_HOPS*2*hop];
+            s->outbuf = new Float32[STREAMHOST_QUEUE_HOPS*2*hop];
+        }
+        s->channels = 0;
+        s->pushed.store(0);
+        s->done.store(0);
+        s->pulled.store(0);
+        s->scheduled.store(false);
+        s->hops.store(0);
+        s->samples.store(0);
+        s->misses.store(0);
+        s->overruns.store(0);
+        s->busy.store(0);
+        s->maxLatency.store(0);
+    }
+    for(UInt32 ix = 0; ix < m_nthreads; ++ix)
+        m_queues[ix].count = 0;
+    
+    m_quit.store(false);
+    m_startTime = now_nsec();
+    m_stopTime  = 0;
+    for(UInt32 ix = 0; ix < m_nthreads; ++ix)
+        m_threads[ix] = new std::thread(thread_entry, this, ix);
+    m_running.store(true, std::memory_order_release);
+}
+
+void TStreamHost::stop()
+{
+    // hops not yet rendered are dropped
+    if(!m_running.load(std::memory_order_acquire))
+        return;
+    m_running.store(false, std::memory_order_release);
+    m_quit.store(true, std::memory_order_release);
+    for(UInt32 ix = 0; ix < m_nthreads; ++ix)
+    {
+        m_threads[ix]->join();
+        delete m_threads[ix];
+        m_threads[ix] = 0;
+    }
+    m_stopTime = now_nsec();
+}
+
+void TStreamHost::set_params(UInt32 ix, tVTuningParams *parms)
+{
+    TStream *s = &m_streams[ix];
+    std::lock_guard<std::mutex> guard(s->parmsLock);
+    s->parms = *parms;
+    s->parmsDirty.store(true, std::memory_order_release);
+}
+
+// ------------------------------------------------------
+
+bool TStreamHost::push(UInt32 ix, const Float32 *inL, const Float32 *inR)
+{
+    TStream *s = &m_streams[ix];
+    UInt32 seq = s->pushed.load(std::memory_order_relaxed);
+    UInt32 nch = (inR ? 2 : 1);
+    
+    if(!m_running.load(std::memory_order_acquire) ||
+       (s->channels && s->channels != nch))
+        return false;
+    if(seq - s->pulled.load(std::memory_order_acquire) >= STREAMHOST_QUEUE_HOPS)
+    {
+        s->overruns.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    s->channels = nch;
+    memcpy(s->slot_in(seq, 0), inL, s->hop*sizeof(Float32));
+    if(inR)
+        memcpy(s->slot_in(seq, 1), inR, s->hop*sizeof(Float32));
+    s->stereo[seq % STREAMHOST_QUEUE_HOPS]  = (0 != inR);
+    s->arrival[seq % STREAMHOST_QUEUE_HOPS] = now_nsec();
+    
+    // seq_cst here and in render_stream(), so that either we see the
+    // stream still scheduled or its worker sees our hop
+    s->pushed.store(seq + 1);
+    if(!s->scheduled.exchange(true))
+        schedule(s, s->home.load(std::memory_order_acquire));
+    return true;
+}
+
+bool TStreamHost::pull(UInt32 ix, Float32 *outL, Float32 *outR)
+{
+    TStream *s = &m_streams[ix];
+    UInt32 seq = s->pulled.load(std::memory_order_relaxed);
+    
+    if(seq == s->done.load(std::memory_order_acquire))
+        return false;
+    memcpy(outL, s->slot_out(seq, 0), s->hop*sizeof(Float32));
+    if(outR)
+        memcpy(outR, s->slot_out(seq, s->stereo[seq % STREAMHOST_QUEUE_HOPS] ? 1 : 0),
+               s->hop*sizeof(Float32));
+    s->pulled.store(seq + 1, std::memory_order_release);
+    return true;
+}
+
+// ------------------------------------------------------
+
+void TStreamHost::thread_entry(TStreamHost *self, UInt32 me)
+{
+    self->run(me);
+}
+
+void TStreamHost::schedule(TStream *s, UInt32 queue)
+{
+    m_queues[queue].put(s);
+}
+
+TStreamHost::TStream *TStreamHost::next_task(UInt32 me)
+{
+    TStream *s = m_queues[me].take_front();
+    for(UInt32 ix = 1; !s && ix < m_nthreads; ++ix)
+        s = m_queues[(me + ix) % m_nthreads].take_back();
+    return s;
+}
+
+void TStreamHost::run(UInt32 me)
+{
+    // each thread has its own floating point environment
+    DAZFZ  env;
+    UInt32 ct = 0;
+    
+    while(!m_quit.load(std::memory_order_acquire))
+    {
+        TStream *s = next_task(me);
+        if(s)
+        {
+            render_stream(s, me);
+            ct = 0;
+        }
+        else if(++ct < SPIN_COUNT)
+            cpu_relax();
+        else if(ct < SPIN_COUNT + YIELD_COUNT)
+            std::this_thread::yield();
+        else
+            std::this_thread::sleep_for(std::chrono::microseconds(NAP_USEC));
+    }
+}
+
+void TStreamHost::render_stream(TStream *s, UInt32 me)
+{
+    // up to STREAMHOST_BATCH_HOPS hops in order, then back on our own
+    // queue if there is more, so that no stream hogs a worker
+    s->home.store(me, std::memory_order_release);
+    if(s->parmsDirty.exchange(false, std::memory_order_acquire))
+    {
+        std::lock_guard<std::mutex> guard(s->parmsLock);
+        s->active    = s->parms;
+        s->haveParms = true;
+    }
+    
+    UInt64 budget = (UInt64)(1.0e9 * m_DeadlineHops * s->hop / s->sampleRate);
+    UInt32 seq    = s->done.load(std::memory_order_relaxed);
+    for(UInt32 n = 0; n < STREAMHOST_BATCH_HOPS; ++n)
+    {
+        if(seq == s->pushed.load(std::memory_order_acquire))
+            break;
+        
+        UInt32 slot = seq % STREAMHOST_QUEUE_HOPS;
+        UInt64 t0   = now_nsec();
+        if(s->stereo[slot])
+            s->proc->render(s->slot_in(seq, 0), s->slot_in(seq, 1),
+                            s->slot_out(seq, 0), s->slot_out(seq, 1),
+                            s->hop, true, s->haveParms ? &s->active : 0);
+        else
+            s->proc->render(s->slot_in(seq, 0), 0, s->slot_out(seq, 0), 0,
+                            s->hop, true, s->haveParms ? &s->active : 0);
+        UInt64 t1 = now_nsec();
+        
+        UInt64 latency = t1 - s->arrival[slot];
+        s->hops.fetch_add(1, std::memory_order_relaxed);
+        s->samples.fetch_add(s->hop, std::memory_order_relaxed);
+        s->busy.fetch_add(t1 - t0, std::memory_order_relaxed);
+        if(latency > budget)
+            s->misses.fetch_add(1, std::memory_order_relaxed);
+        if(latency > s->maxLatency.load(std::memory_order_relaxed))
+            s->maxLatency.store(latency, std::memory_order_relaxed);
+        
+        s->done.store(++seq, std::memory_order_release);
+    }
+    
+    s->scheduled.store(false);
+    if(seq != s->pushed.load() && !s->scheduled.exchange(true))
+        schedule(s, me);
+}
+
+// ------------------------------------------------------
+
+void TStreamHost::get_stats(UInt32 ix, tStreamStats *stats)
+{
+    TStream *s = &m_streams[ix];
+    
+    stats->hops        = s->hops.load(std::memory_order_relaxed);
+    stats->samples     = s->samples.load(std::memory_order_relaxed);
+    stats->misses      = s->misses.load(std::memory_order_relaxed);
+    stats->overruns    = s->overruns.load(std::memory_order_relaxed);
+    stats->busy        = 1.0e-9 * s->busy.load(std::memory_order_relaxed);
+    stats->max_latency = 1.0e-9 * s->maxLatency.load(std::memory_order_relaxed);
+    UInt64 until       = (m_stopTime ? m_stopTime : now_nsec());
+    stats->elapsed     = (m_startTime ? 1.0e-9 * (until - m_startTime) : 0.0);
+    stats->throughput  = (stats->elapsed > 0.0 ? stats->samples / stats->elapsed : 0.0);
+}
+
+void TStreamHost::get_total_stats(tStreamStats *stats)
+{
+    tStreamStats one;
+    
+    memset(stats, 0, sizeof(tStreamStats));
+    for(UInt32 ix = 0; ix < m_nstreams; ++ix)
+    {
+        get_stats(ix, &one);
+        stats->hops        += one.hops;
+        stats->samples     += one.samples;
+        stats->misses      += one.misses;
+        stats->overruns    += one.overruns;
+        stats->busy        += one.busy;
+        stats->max_latency  = max(stats->max_latency, one.max_latency);
+        stats->elapsed      = one.elapsed;
+    }
+    stats->throughput = (stats->elapsed > 0.0 ? stats->samples / stats->elapsed : 0.0);
+}
+
+// -- end of tstreamhost.cpp -- //
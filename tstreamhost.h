@@ -0,0 +1,150 @@
+// tstreamhost.h -- many Crescendo streams on a work-stealing thread pool
+// DM/RAL  10/26
+// -------------------------------------------------------------
+
+/* -----------------------------------------------------------------------------
+ Copyright (c) 2016 Refined Audiometrics Laboratory, LLC
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ 3. The names of the authors and contributors may not be used to endorse
+ or promote products derived from this software without specific prior
+ written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+ ------------------------------------------------------------------------------- */
+#ifndef __TSTREAMHOST_H__
+#define __TSTREAMHOST_H__
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include "my_types.h"
+#include "smart_ptr.h"
+#include "vTuningParams.h"
+
+class TCrescendo;
+
+// -------------------------------------------------------------
+// TStreamHost -- owns a set of independent processors, one per stream,
+// and renders them on a pool of worker threads.
+//
+//   host.get_processor(ix)->set_...   // options, before start()
+//   host.start();
+//   host.push(ix, inL, inR);          // one hop of input, any thread
+//   host.pull(ix, outL, outR);        // one hop of output, when ready
+//
+// Streams are fed and drained one hop at a time, get_hop(ix) host
+// samples, through a ring of STREAMHOST_QUEUE_HOPS slots. push() and
+// pull() for any one stream must come from one thread at a time, and
+// never block: a full ring refuses the push, an empty one the pull.
+// A stream is mono or stereo from its first push after start() on; a
+// push with the other channel count is refused too, the processor's
+// right channel would not be in step with the left.
+//
+// stop() drops the hops not yet rendered or pulled, and start() begins
+// the rings and the counters afresh. The processors are not reset: their
+// signal history, levels and gains carry on from the last hop rendered,
+// so the first hops after a restart still hear the end of the last run.
+//
+// A stream with input waiting is a task on the pool. Only one worker
+// holds a stream at any time, so its hops are rendered in order. Each
+// worker keeps a queue of its own and steals from the others when it
+// runs dry; a stream is queued back to the worker that ran it last.
+// Idle workers spin, then yield, then nap, as TWorker does.
+
+#define STREAMHOST_QUEUE_HOPS   16
+#define STREAMHOST_BATCH_HOPS    4   // hops per turn, before requeueing
+
+// counters for one stream, or summed over all of them
+struct tStreamStats {
+    UInt64  hops;          // hops rendered
+    UInt64  samples;       // host samples rendered, per channel
+    UInt64  misses;        // hops finished after their deadline
+    UInt64  overruns;      // pushes refused, ring full
+    Float64 busy;          // seconds spent rendering
+    Float64 max_latency;   // longest push to finish, seconds
+    Float64 elapsed;       // seconds from start() to now, or to stop()
+    Float64 throughput;    // samples per second of elapsed time
+};
+
+class TStreamHost
+{
+    struct TStream;
+    struct TWorkQueue;
+    
+    TStream      *m_streams;
+    UInt32        m_nstreams;
+    TWorkQueue   *m_queues;
+    std::thread **m_threads;
+    UInt32        m_nthreads;
+    
+    std::atomic<bool> m_quit;
+    std::atomic<bool> m_running;
+    UInt64            m_startTime;
+    UInt64            m_stopTime;
+    Float64           m_DeadlineHops;
+    
+    void run(UInt32 me);
+    static void thread_entry(TStreamHost *self, UInt32 me);
+    
+    void schedule(TStream *s, UInt32 queue);
+    TStream *next_task(UInt32 me);
+    void render_stream(TStream *s, UInt32 me);
+    
+public:
+    // nthreads 0 for one per core
+    TStreamHost(UInt32 nstreams, Float64 sampleRate, UInt32 nthreads = 0);
+    virtual ~TStreamHost();
+    
+    UInt32 get_NumStreams()
+    { return m_nstreams; }
+    
+    UInt32 get_NumThreads()
+    { return m_nthreads; }
+    
+    // configure before start(), or after stop()
+    TCrescendo* get_processor(UInt32 ix);
+    
+    // a hop counts as missed when it finishes later than this many
+    // hop periods after its push, 1 by default
+    void set_DeadlineHops(Float64 hops)
+    { m_DeadlineHops = hops; }
+    
+    void start();
+    void stop();
+    
+    // host samples per hop, fixed by start()
+    UInt32 get_hop(UInt32 ix);
+    
+    // takes effect from the next hop rendered
+    void set_params(UInt32 ix, tVTuningParams *parms);
+    
+    // inR and outR null for a mono stream, see above
+    bool push(UInt32 ix, const Float32 *inL, const Float32 *inR);
+    bool pull(UInt32 ix, Float32 *outL, Float32 *outR);
+    
+    void get_stats(UInt32 ix, tStreamStats *stats);
+    void get_total_stats(tStreamStats *stats);
+};
+
+#endif // __TSTREAMHOST_H__
+
+// -- end of tstreamhost.h -- //
@@ -0,0 +1,132 @@
+// tworker.cpp -- a helper thread with a lock-free rendezvous
+// DM/RAL  10/26
+// ------------------------------------------------------
+
+/* -----------------------------------------------------------------------------
+ Copyright (c) 2016 Refined Audiometrics Laboratory, LLC
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ 3. The names of the authors and contributors may not be used to endorse
+ or promote products derived from this software without specific prior
+ written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+ ------------------------------------------------------------------------------- */
+
+#include <chrono>
+
+#include "tworker.h"
+#include "useful_math.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_IX86)
+#include <emmintrin.h>
+#define cpu_relax()   _mm_pause()
+#else
+#define cpu_relax()
+#endif
+
+// spin this long before yielding, then yield this long before napping
+#define SPIN_COUNT    1024
+#define YIELD_COUNT   4096
+#define NAP_USEC      50
+
+// ------------------------------------------------------
+
+TWorker::TWorker()
+{
+	m_job  = 0;
+	m_arg  = 0;
+	m_posted.store(0);
+	m_done.store(0);
+	m_quit.store(false);
+	m_thread = new std::thread(thread_entry, this);
+}
+
+TWorker::~TWorker()
+{
+	m_quit.store(true, std::memory_order_release);
+	m_posted.fetch_add(1, std::memory_order_release);
+	m_thread->join();
+	delete m_thread;
+}
+
+void TWorker::thread_entry(TWorker *self)
+{
+	self->run();
+}
+
+void TWorker::run()
+{
+	UInt32 seen = 0;
+	for(;;)
+	{
+		UInt32 seq;
+		UInt32 ct = 0;
+		while((seq = m_posted.load(std::memory_order_acquire)) == seen)
+		{
+			if(++ct < SPIN_COUNT)
+				cpu_relax();
+			else if(ct < SPIN_COUNT + YIELD_COUNT)
+				std::this_thread::yield();
+			else
+				std::this_thread::sleep_for(std::chrono::microseconds(NAP_USEC));
+		}
+		if(m_quit.load(std::memory_order_acquire))
+			break;
+		{
+			// each thread has its own floating point environment
+			DAZFZ env;
+			m_job(m_arg);
+		}
+		seen = seq;
+		m_done.store(seq, std::memory_order_release);
+	}
+}
+
+// ------------------------------------------------------
+
+void TWorker::post(tWorkerJob job, void *arg)
+{
+	m_job = job;
+	m_arg = arg;
+	m_posted.fetch_add(1, std::memory_order_release);
+}
+
+bool TWorker::busy()
+{
+	return (m_done.load(std::memory_order_acquire) !=
+			m_posted.load(std::memory_order_relaxed));
+}
+
+void TWorker::wait()
+{
+	UInt32 seq = m_posted.load(std::memory_order_relaxed);
+	UInt32 ct  = 0;
+	while(m_done.load(std::memory_order_acquire) != seq)
+	{
+		if(++ct < SPIN_COUNT)
+			cpu_relax();
+		else
+			std::this_thread::yield();
+	}
+}
+
+// -- end of tworker.cpp -- //
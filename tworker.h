@@ -0,0 +1,81 @@
+// tworker.h -- a helper thread with a lock-free rendezvous
+// DM/RAL  10/26
+// -------------------------------------------------------------
+
+/* -----------------------------------------------------------------------------
+ Copyright (c) 2016 Refined Audiometrics Laboratory, LLC
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ 3. The names of the authors and contributors may not be used to endorse
+ or promote products derived from this software without specific prior
+ written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS ``AS IS'' AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ SUCH DAMAGE.
+ ------------------------------------------------------------------------------- */
+#ifndef __TWORKER_H__
+#define __TWORKER_H__
+
+#include <atomic>
+#include <thread>
+#include "my_types.h"
+
+// -------------------------------------------------------------
+// TWorker -- one persistent thread that runs a job handed over by
+// its owner, while the owner gets on with something else.
+//
+//   worker.post(fn, arg);   // returns at once
+//   ... owner work ...
+//   worker.wait();          // returns when fn(arg) is done
+//
+// Handoff is by sequence counters, no locks and no system calls on
+// the owner's side, so post() and wait() are safe on an audio thread.
+// The owner spins while waiting. The worker spins briefly after each
+// job, then yields, then naps in short steps while there is nothing to do.
+// One owner only, and at most one job in flight.
+
+typedef void (*tWorkerJob)(void *arg);
+
+class TWorker
+{
+	std::thread          *m_thread;
+	std::atomic<UInt32>   m_posted;
+	std::atomic<UInt32>   m_done;
+	std::atomic<bool>     m_quit;
+	tWorkerJob            m_job;
+	void                 *m_arg;
+
+	void run();
+	static void thread_entry(TWorker *self);
+
+public:
+	TWorker();
+	virtual ~TWorker();
+
+	void post(tWorkerJob job, void *arg);
+	void wait();
+
+	// true while a posted job has yet to finish
+	bool busy();
+};
+
+#endif // __TWORKER_H__
+
+// -- end of tworker.h -- //
@@ -41,30 +41,82 @@
 #include <math.h>
 #include <fenv.h>
 #include "my_types.h"
+#include "simd_vec.h"
 
 // -------------------------------------------------------------
-// DAZFZ - a class that automatically instantiates the DAZ and FZ flags
-// in the x87 environment. It will restore the environment on destruction.
+// DAZFZ - a class that automatically sets the flush-to-zero and
+// denormals-are-zero modes of the vector unit for the current thread.
+// It will restore the previous modes on destruction.
 //
-// But note that this only prevents exceptions and does nothing for X87 stalls.
-// And it has no effect on the X86/64 instruction set.
-// So, sadly, we still need to dither for denormals...
+// On x86 that is FTZ|DAZ in MXCSR, on 64-bit ARM it is FPCR.FZ.
+// Elsewhere the guard does nothing, DAZFZ_AVAILABLE is 0, and we
+// still need to dither for denormals.
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 1))
+#include <xmmintrin.h>
+
+#define DAZFZ_AVAILABLE    1
+#define DAZFZ_MXCSR_BITS   0x8040   // FTZ (bit 15) | DAZ (bit 6)
+
+class DAZFZ
+{
+    unsigned int savcsr;
+    
+public:
+    DAZFZ()
+    {
+        savcsr = _mm_getcsr();
+        _mm_setcsr(savcsr | DAZFZ_MXCSR_BITS);
+    }
+    
+    ~DAZFZ()
+    { _mm_setcsr(savcsr); }
+    
+    static bool active()
+    { return (DAZFZ_MXCSR_BITS == (_mm_getcsr() & DAZFZ_MXCSR_BITS)); }
+};
+
+#elif defined(__aarch64__)
+
+#define DAZFZ_AVAILABLE    1
+#define DAZFZ_FPCR_FZ      (1ULL << 24)
 
 class DAZFZ
 {
-    fenv_t savenv;
+    UInt64 savfpcr;
+    
+    static UInt64 get_fpcr()
+    { UInt64 r; __asm__ __volatile__("mrs %0, fpcr" : "=r"(r)); return r; }
+    
+    static void set_fpcr(UInt64 r)
+    { __asm__ __volatile__("msr fpcr, %0" : : "r"(r)); }
     
 public:
     DAZFZ()
     {
-        fegetenv(&savenv);
-        fesetenv(FE_DFL_DISABLE_SSE_DENORMS_ENV);
+        savfpcr = get_fpcr();
+        set_fpcr(savfpcr | DAZFZ_FPCR_FZ);
     }
     
     ~DAZFZ()
-    { fesetenv(&savenv); }
+    { set_fpcr(savfpcr); }
+    
+    static bool active()
+    { return (0 != (get_fpcr() & DAZFZ_FPCR_FZ)); }
+};
+
+#else
+
+#define DAZFZ_AVAILABLE    0
+
+class DAZFZ
+{
+public:
+    static bool active()
+    { return false; }
 };
 
+#endif
 
 
 // -------------------------------------------------------------
@@ -106,6 +158,88 @@ inline Float64 ampl10(Float64 xdb)
 inline Float32 ampl10f(Float32 xdb)
 { return powf(10.0f, 0.1f*xdb); }
 
+// -------------------------------------------------------------
+// Block versions of db10 and ampl20, VD_LANES at a time, for the
+// per-hop traffic in the Bark and FT gain stages. Polynomial
+// approximations after splitting off the binary exponent:
+//
+//   vdb10    log(m), m in [sqrt(1/2), sqrt(2)), by the atanh series
+//            in f = (m-1)/(m+1) through f^7.
+//            Max error 2e-7 dB for normal positive inputs,
+//            src <= 0 gives -140 like db10.
+//
+//   vampl20  2^r, |r| <= 1/2, by Taylor series through r^7.
+//            Max relative error 1e-8 (1e-7 dB), inputs are clamped
+//            to +/-6020 dB.
+//
+// Both are far inside the 0.001 dB that anyone could hear. Subnormal
+// inputs to vdb10 are not worth the trouble, they come out somewhere
+// below -3000 dB instead of exactly.
+
+inline TVecD vd_db10(TVecD x)
+{
+    const TVecD one = vd_splat(1.0);
+    TVecD e;
+    TVecD m   = vd_split_exp(x, e);
+    TMaskD hi = vd_gt(m, vd_splat(1.4142135623730951));
+    m = vd_select(hi, vd_mul(m, vd_splat(0.5)), m);
+    e = vd_select(hi, vd_add(e, one), e);
+    TVecD f = vd_div(vd_sub(m, one), vd_add(m, one));
+    TVecD z = vd_mul(f, f);
+    TVecD p = vd_add(vd_splat(1.0/5.0), vd_mul(z, vd_splat(1.0/7.0)));
+    p = vd_add(vd_splat(1.0/3.0), vd_mul(z, p));
+    p = vd_add(one, vd_mul(z, p));
+    // 10*log10(x) = 10/ln(10) * (2 f p + e ln 2)
+    TVecD lnx = vd_add(vd_mul(vd_mul(vd_splat(2.0), f), p),
+                       vd_mul(e, vd_splat(0.69314718055994531)));
+    TVecD db  = vd_mul(lnx, vd_splat(4.3429448190325182));
+    return vd_select(vd_gt(x, vd_splat(0.0)), db, vd_splat(-140.0));
+}
+
+inline TVecD vd_ampl20(TVecD xdb)
+{
+    // 10^(x/20) = 2^(x log2(10)/20)
+    TVecD y = vd_mul(xdb, vd_splat(0.16609640474436813));
+    y = vd_min(vd_max(y, vd_splat(-1000.0)), vd_splat(1000.0));
+    TVecD t = vd_add(y, vd_splat(VD_ROUND_MAGIC));
+    TVecD r = vd_mul(vd_sub(y, vd_sub(t, vd_splat(VD_ROUND_MAGIC))),
+                     vd_splat(0.69314718055994531));
+    TVecD p = vd_add(vd_splat(1.0/720.0), vd_mul(r, vd_splat(1.0/5040.0)));
+    p = vd_add(vd_splat(1.0/120.0), vd_mul(r, p));
+    p = vd_add(vd_splat(1.0/24.0),  vd_mul(r, p));
+    p = vd_add(vd_splat(1.0/6.0),   vd_mul(r, p));
+    p = vd_add(vd_splat(0.5),       vd_mul(r, p));
+    p = vd_add(vd_splat(1.0),       vd_mul(r, p));
+    p = vd_add(vd_splat(1.0),       vd_mul(r, p));
+    return vd_mul(p, vd_pow2_magic(t));
+}
+
+inline void vdb10(const Float64 *src, Float64 *dst, UInt32 nel)
+{
+    UInt32 ix = 0;
+    for(; ix + VD_LANES <= nel; ix += VD_LANES)
+        vd_store(dst+ix, vd_db10(vd_load(src+ix)));
+    for(; ix < nel; ++ix)
+    {
+        Float64 tmp[VD_LANES] = { src[ix] };
+        vd_store(tmp, vd_db10(vd_load(tmp)));
+        dst[ix] = tmp[0];
+    }
+}
+
+inline void vampl20(const Float64 *src, Float64 *dst, UInt32 nel)
+{
+    UInt32 ix = 0;
+    for(; ix + VD_LANES <= nel; ix += VD_LANES)
+        vd_store(dst+ix, vd_ampl20(vd_load(src+ix)));
+    for(; ix < nel; ++ix)
+    {
+        Float64 tmp[VD_LANES] = { src[ix] };
+        vd_store(tmp, vd_ampl20(vd_load(tmp)));
+        dst[ix] = tmp[0];
+    }
+}
+
 inline Float64 rdz(Float64 v)
 {
     return (((v > -1e-20) && (v < 1e-20)) ? 0.0 : v);